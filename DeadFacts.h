@@ -0,0 +1,329 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Per translation unit facts (declarations, definitions and references) and
+// their binary encoding. The plugin writes them into a non-allocated
+// .deadmethod section of the object file; the whole-program driver reads them
+// back from objects and archives and merges them.
+//
+// All the integers are 32-bit little endian, strings are length-prefixed.
+// A section may hold several records back to back (e.g. after ld -r).
+//
+#ifndef DEAD_METHOD_FACTS_H
+#define DEAD_METHOD_FACTS_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace deadfacts {
+
+static const char SectionName[] = ".deadmethod";
+static const uint32_t Magic = 0x44414544; // "DEAD"
+static const uint32_t Version = 7;
+
+enum MethodFlags {
+  MF_Private = 1 << 0,
+  MF_Defined = 1 << 1,
+  // constructor or destructor, never reported
+  MF_Structor = 1 << 2,
+  MF_Templated = 1 << 3,
+  // external linkage and default visibility: exported from a shared library
+  MF_Exported = 1 << 4,
+  MF_Virtual = 1 << 5,
+  MF_Pure = 1 << 6,
+  // also MF_Structor
+  MF_Destructor = 1 << 7,
+  // member template or member of a class template: a pattern, which emits
+  // nothing itself (the uses name the specializations)
+  MF_Dependent = 1 << 8
+};
+
+struct ClassFact {
+  std::string key;
+  std::string name;
+  // the key of the enclosing class for nested classes, else empty
+  std::string outer;
+  bool defined;
+  // of the definition, if any
+  std::string file;
+  uint32_t line;
+  std::vector<std::string> friendFunctions;
+  std::vector<std::string> friendClasses;
+  // direct bases
+  std::vector<std::string> bases;
+  // for dynamic classes defined here: bytes of the vtable pointers in each
+  // object and of the vtables, estimated; 0 for the others
+  uint32_t vptrBytes;
+  uint32_t vtableBytes;
+  // bytes of an object, for the dynamic classes with vptrBytes
+  uint32_t size;
+  // dynamic, but the vtable pointers cannot go: virtual bases, or a
+  // template whose instantiations are not seen
+  bool vptrRequired;
+
+  ClassFact()
+    : defined(false), line(0), vptrBytes(0), vtableBytes(0), size(0),
+    vptrRequired(false) { }
+};
+
+struct MethodFact {
+  std::string key;
+  std::string classKey;
+  std::string name;
+  std::string file;
+  uint32_t line;
+  uint32_t flags;
+  // microseconds of code generation for the body (profile-cost), 0 if not
+  // measured
+  uint32_t cost;
+
+  MethodFact() : line(0), flags(0), cost(0) { }
+};
+
+// a friend function and whether this translation unit defines it
+struct FunctionFact {
+  std::string key;
+  bool defined;
+
+  FunctionFact() : defined(false) { }
+};
+
+struct RefFact {
+  std::string key;
+  uint32_t count;
+  // of those, virtual method calls dispatched through the vtable and
+  // addresses taken (member pointers dispatch too)
+  uint32_t virtualCount;
+
+  RefFact() : count(0), virtualCount(0) { }
+};
+
+struct TUFacts {
+  std::string tu;
+  std::vector<ClassFact> classes;
+  std::vector<MethodFact> methods;
+  std::vector<FunctionFact> functions;
+  std::vector<RefFact> refs;
+  // dynamic classes whose vtables are consulted other than by calling a
+  // virtual method: dynamic_cast, typeid, delete through a base
+  std::vector<std::string> dynamicUses;
+};
+
+// receives the facts of translation units as they are read
+class FactSink {
+  public:
+    virtual ~FactSink() { }
+    virtual void Add(const TUFacts &facts) = 0;
+};
+
+// encoding helpers
+inline void WriteU32(llvm::raw_ostream &os, uint32_t v) {
+  char b[4] = { char(v), char(v >> 8), char(v >> 16), char(v >> 24) };
+  os.write(b, 4);
+}
+
+inline void WriteString(llvm::raw_ostream &os, llvm::StringRef s) {
+  WriteU32(os, s.size());
+  os << s;
+}
+
+inline void WriteStrings(llvm::raw_ostream &os,
+    const std::vector<std::string> &v) {
+  WriteU32(os, v.size());
+  for (unsigned i = 0, e = v.size(); i != e; ++i)
+    WriteString(os, v[i]);
+}
+
+inline bool ReadU32(llvm::StringRef &in, uint32_t &v) {
+  if (in.size() < 4)
+    return false;
+  const unsigned char *b = reinterpret_cast<const unsigned char *>(in.data());
+  v = uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 |
+    uint32_t(b[3]) << 24;
+  in = in.substr(4);
+  return true;
+}
+
+// the length of a list; each element takes 4 bytes at least, so a corrupt
+// count is caught before anything is allocated for it
+inline bool ReadCount(llvm::StringRef &in, uint32_t &n) {
+  return ReadU32(in, n) && n <= in.size() / 4;
+}
+
+inline bool ReadString(llvm::StringRef &in, std::string &s) {
+  uint32_t size;
+  if (!ReadU32(in, size) || in.size() < size)
+    return false;
+  s = in.substr(0, size);
+  in = in.substr(size);
+  return true;
+}
+
+inline bool ReadStrings(llvm::StringRef &in, std::vector<std::string> &v) {
+  uint32_t n;
+  if (!ReadCount(in, n))
+    return false;
+  v.resize(n);
+  for (unsigned i = 0; i != n; ++i)
+    if (!ReadString(in, v[i]))
+      return false;
+  return true;
+}
+
+// serialize one record (header included)
+inline void WriteFacts(llvm::raw_ostream &out, const TUFacts &f) {
+  std::string payload;
+  llvm::raw_string_ostream os(payload);
+
+  WriteString(os, f.tu);
+  WriteU32(os, f.classes.size());
+  for (unsigned i = 0, e = f.classes.size(); i != e; ++i) {
+    const ClassFact &c = f.classes[i];
+    WriteString(os, c.key);
+    WriteString(os, c.name);
+    WriteString(os, c.outer);
+    WriteU32(os, c.defined);
+    WriteString(os, c.file);
+    WriteU32(os, c.line);
+    WriteStrings(os, c.friendFunctions);
+    WriteStrings(os, c.friendClasses);
+    WriteStrings(os, c.bases);
+    WriteU32(os, c.vptrBytes);
+    WriteU32(os, c.vtableBytes);
+    WriteU32(os, c.size);
+    WriteU32(os, c.vptrRequired);
+  }
+  WriteU32(os, f.methods.size());
+  for (unsigned i = 0, e = f.methods.size(); i != e; ++i) {
+    const MethodFact &m = f.methods[i];
+    WriteString(os, m.key);
+    WriteString(os, m.classKey);
+    WriteString(os, m.name);
+    WriteString(os, m.file);
+    WriteU32(os, m.line);
+    WriteU32(os, m.flags);
+    WriteU32(os, m.cost);
+  }
+  WriteU32(os, f.functions.size());
+  for (unsigned i = 0, e = f.functions.size(); i != e; ++i) {
+    WriteString(os, f.functions[i].key);
+    WriteU32(os, f.functions[i].defined);
+  }
+  WriteU32(os, f.refs.size());
+  for (unsigned i = 0, e = f.refs.size(); i != e; ++i) {
+    WriteString(os, f.refs[i].key);
+    WriteU32(os, f.refs[i].count);
+    WriteU32(os, f.refs[i].virtualCount);
+  }
+  WriteStrings(os, f.dynamicUses);
+  os.flush();
+
+  WriteU32(out, Magic);
+  WriteU32(out, Version);
+  WriteU32(out, payload.size());
+  out << payload;
+}
+
+// whether the buffer starts with a facts record
+inline bool HasMagic(llvm::StringRef in) {
+  uint32_t magic;
+  return ReadU32(in, magic) && magic == Magic;
+}
+
+// Read one record from the front of 'in' and advance past it. Zero bytes
+// between records (section padding) are skipped. Returns false and sets
+// 'error' on malformed input.
+inline bool ReadFacts(llvm::StringRef &in, TUFacts &f, std::string &error) {
+  while (!in.empty() && in[0] == '\0')
+    in = in.substr(1);
+
+  uint32_t magic, version, size;
+  if (!ReadU32(in, magic) || magic != Magic) {
+    error = "bad magic";
+    return false;
+  }
+  if (!ReadU32(in, version) || version != Version) {
+    error = "unsupported version";
+    return false;
+  }
+  if (!ReadU32(in, size) || in.size() < size) {
+    error = "truncated record";
+    return false;
+  }
+  llvm::StringRef p = in.substr(0, size);
+  in = in.substr(size);
+
+  uint32_t n, v;
+  bool ok = ReadString(p, f.tu) && ReadCount(p, n);
+  f.classes.resize(ok ? n : 0);
+  for (unsigned i = 0, e = f.classes.size(); ok && i != e; ++i) {
+    ClassFact &c = f.classes[i];
+    ok = ReadString(p, c.key) && ReadString(p, c.name) &&
+      ReadString(p, c.outer) && ReadU32(p, v) && ReadString(p, c.file) &&
+      ReadU32(p, c.line) && ReadStrings(p, c.friendFunctions) &&
+      ReadStrings(p, c.friendClasses);
+    c.defined = v;
+    ok = ok && ReadStrings(p, c.bases) && ReadU32(p, c.vptrBytes) &&
+      ReadU32(p, c.vtableBytes) && ReadU32(p, c.size) && ReadU32(p, v);
+    c.vptrRequired = v;
+  }
+  ok = ok && ReadCount(p, n);
+  f.methods.resize(ok ? n : 0);
+  for (unsigned i = 0, e = f.methods.size(); ok && i != e; ++i) {
+    MethodFact &m = f.methods[i];
+    ok = ReadString(p, m.key) && ReadString(p, m.classKey) &&
+      ReadString(p, m.name) && ReadString(p, m.file) &&
+      ReadU32(p, m.line) && ReadU32(p, m.flags) && ReadU32(p, m.cost);
+  }
+  ok = ok && ReadCount(p, n);
+  f.functions.resize(ok ? n : 0);
+  for (unsigned i = 0, e = f.functions.size(); ok && i != e; ++i) {
+    ok = ReadString(p, f.functions[i].key) && ReadU32(p, v);
+    f.functions[i].defined = v;
+  }
+  ok = ok && ReadCount(p, n);
+  f.refs.resize(ok ? n : 0);
+  for (unsigned i = 0, e = f.refs.size(); ok && i != e; ++i)
+    ok = ReadString(p, f.refs[i].key) && ReadU32(p, f.refs[i].count) &&
+      ReadU32(p, f.refs[i].virtualCount);
+  ok = ok && ReadStrings(p, f.dynamicUses);
+
+  if (!ok)
+    error = "corrupted record";
+  return ok;
+}
+
+// Assembly that places 'data' into the .deadmethod section. The section is
+// not allocated, so it costs nothing at run time; alignment is 1 so records
+// of several objects stay contiguous when linked together.
+inline std::string SectionAsm(llvm::StringRef data) {
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  os << "\t.pushsection " << SectionName << ",\"\"\n";
+  for (size_t i = 0, e = data.size(); i < e; i += 64) {
+    os << "\t.ascii \"";
+    for (size_t j = i, je = std::min(e, i + 64); j != je; ++j) {
+      unsigned char c = data[j];
+      if (c == '"' || c == '\\')
+        os << '\\' << c;
+      else if (c >= 0x20 && c < 0x7f)
+        os << c;
+      else
+        os << '\\' << char('0' + (c >> 6)) << char('0' + ((c >> 3) & 7))
+          << char('0' + (c & 7));
+    }
+    os << "\"\n";
+  }
+  os << "\t.popsection\n";
+  os.flush();
+  return text;
+}
+
+}
+
+#endif
@@ -6,209 +6,334 @@
 // defined in the current translation unit and these whose friends are not
 // defined here.
 //
+// The analysis itself lives in DeadMethodAnalysis; this file turns its
+// results into diagnostics and hooks it into the compiler.
+//
 #include "clang/Frontend/FrontendPluginRegistry.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/AST.h"
-#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/CodeGen/CodeGenAction.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include "DeadFacts.h"
+#include "DeadMethodAnalysis.h"
+#include "DeadMethodCost.h"
+#include <algorithm>
+#include <pthread.h>
 
 using namespace clang;
+using namespace deadmethod;
 
 namespace {
 
-typedef llvm::DenseSet<const CXXMethodDecl *> MethodSet;
-typedef llvm::DenseSet<const Type *> ClassSet;
 typedef std::vector<std::string> FileList;
 
-// set manipulation functions
-bool Contains(ASTContext &ctx, ClassSet &set, const QualType elt) {
-  const Type *t = ctx.getCanonicalType(elt).getTypePtrOrNull();
-  if (!t)
-    return false;
-  return set.find(t) != set.end();
-}
-
-void Insert(ASTContext &ctx, ClassSet &set, const QualType elt) {
-  const Type *t = ctx.getCanonicalType(elt).getTypePtrOrNull();
-  if (t)
-    set.insert(t);
-}
-
-// mark off the used methods
-class DeclRemover : public RecursiveASTVisitor<DeclRemover> {
+// Runs the AST walks on a worker thread, so that they overlap with code
+// generation when the plugin drives the backend itself. The walks only read
+// the AST; everything touching the SourceManager or diagnostics is left for
+// the main thread after Join().
+class BackgroundAnalysis {
   public:
-    DeclRemover(MethodSet &privateOnes) : unused(privateOnes) { }
+    BackgroundAnalysis() : started(false) { }
+
+    // start collecting on a worker thread; falls back to doing the work in
+    // place if no thread could be created, or if the AST comes partly from a
+    // PCH or modules: those deserialize declarations and bodies lazily, on
+    // first access, and both threads would write the ASTContext
+    void Start(ASTContext &ctx, const AnalysisOptions &opts) {
+      if (ctx.getExternalSource()) {
+        RunHere(ctx, opts);
+        return;
+      }
+      analysis.reset(new Analysis(ctx, opts));
+      // what needs the ASTContext is taken here, before code generation
+      analysis->Snapshot();
+      started = true;
+      if (pthread_create(&thread, 0, &BackgroundAnalysis::Run, this) != 0) {
+        started = false;
+        analysis->Collect();
+      }
+    }
 
-    bool VisitMemberExpr(MemberExpr *e) {
-      const ValueDecl *d = e->getMemberDecl();
-      FlagMethodUsed(dyn_cast_or_null<CXXMethodDecl>(d));
-      return true;
+    // collect on the calling thread
+    void RunHere(ASTContext &ctx, const AnalysisOptions &opts) {
+      analysis.reset(new Analysis(ctx, opts));
+      analysis->Snapshot();
+      analysis->Collect();
     }
 
-    bool VisitDeclRefExpr(DeclRefExpr *e) {
-      FlagMethodUsed(dyn_cast_or_null<CXXMethodDecl>(e->getDecl()));
-      return true;
+    // wait for the worker and resolve the results
+    void Finish(AnalysisResult &result) {
+      if (started)
+        pthread_join(thread, 0);
+      started = false;
+      analysis->Resolve(result);
     }
 
+    bool WasStarted() const { return analysis.get() != 0; }
   private:
-    MethodSet &unused;
-
-    // remove the method from the unused methods set; ignore NULL silently
-    void FlagMethodUsed(const CXXMethodDecl *m) {
-      if (!m || !(m = m->getCanonicalDecl()))
-        return;
+    llvm::OwningPtr<Analysis> analysis;
+    bool started;
+    pthread_t thread;
 
-      unused.erase(m);
+    static void *Run(void *self) {
+      static_cast<BackgroundAnalysis *>(self)->analysis->Collect();
+      return 0;
     }
 };
 
-// gather:
-//  - classes with undefined methods
-//  - declared private methods
-class DeclCollector : public RecursiveASTVisitor<DeclCollector> {
+// Computes the facts of the translation unit and feeds them to the code
+// generator as file-scope assembly, so that they end up in the .deadmethod
+// section of the object file.
+class FactEmbedder : public ASTConsumer {
   public:
-    DeclCollector(ASTContext &c, ClassSet &u, MethodSet &p, bool t,
-        FileList &b)
-      : ctx(c), undefinedClasses(u), privateMethods(p), templates(t),
-      blacklist(b) { }
+    FactEmbedder(ASTConsumer *c, CostModel *m, PerfSample *s)
+      : codeGen(c), costs(m), counters(s) { }
 
-    bool VisitCXXMethodDecl(CXXMethodDecl *m) {
-      const CXXRecordDecl *r;
-      m = m->getCanonicalDecl();
-      if (!m || !(r = m->getParent()) || !(r = r->getCanonicalDecl()))
-        return true;
-
-      if (!m->isDefined())
-        MarkUndefined(r);
-
-      // only private methods are concerned
-      if (m->getAccess() != AS_private)
-        return true;
-
-      // omit template methods if flag on
-      if (IsTemplated(m) && !templates)
-        return true;
-
-      // omit blacklist entries
-      if (IsBlacklisted(m))
-        return true;
-
-      privateMethods.insert(m);
-
-      return true;
-    }
-
-    bool VisitCXXRecordDecl(CXXRecordDecl *r) {
-      r = r->getCanonicalDecl();
-      if (r && !r->hasDefinition())
-        MarkUndefined(r);
-
-      return true;
+    virtual void HandleTranslationUnit(ASTContext &ctx) {
+      deadfacts::TUFacts facts;
+      CollectFacts(ctx, facts, costs, counters);
+
+      std::string blob;
+      llvm::raw_string_ostream os(blob);
+      deadfacts::WriteFacts(os, facts);
+      os.flush();
+
+      const std::string text = deadfacts::SectionAsm(blob);
+      QualType strType = ctx.getConstantArrayType(ctx.CharTy,
+          llvm::APInt(32, text.size() + 1), ArrayType::Normal, 0);
+      StringLiteral *str = StringLiteral::Create(ctx, text,
+          StringLiteral::Ascii, false, strType, SourceLocation());
+      FileScopeAsmDecl *asmDecl = FileScopeAsmDecl::Create(ctx,
+          ctx.getTranslationUnitDecl(), str, SourceLocation(),
+          SourceLocation());
+      codeGen->HandleTopLevelDecl(DeclGroupRef(asmDecl));
     }
   private:
-    ASTContext &ctx;
-    ClassSet &undefinedClasses;
-    MethodSet &privateMethods;
-    bool templates;
-    FileList &blacklist;
-
-    void MarkUndefined(const CXXRecordDecl *r) {
-      Insert(ctx, undefinedClasses, ctx.getRecordType(r));
-    }
-
-    bool IsTemplated(const CXXMethodDecl *m) {
-      if (m->getDescribedFunctionTemplate())
-        return true;
-      return false;
-    }
-
-    bool IsBlacklisted(const CXXMethodDecl *m) {
-      const SourceManager &srcManager = ctx.getSourceManager();
-      const SourceLocation loc = m->getLocation();
-      const std::string file = srcManager.getPresumedLoc(loc).getFilename();
-      FileList::const_iterator it = std::lower_bound(blacklist.begin(),
-          blacklist.end(), file);
-      return it != blacklist.end() && *it == file;
-    }
+    ASTConsumer *codeGen;
+    CostModel *costs;
+    PerfSample *counters;
 };
 
 // deal with every translation unit separately
 class DeadConsumer : public ASTConsumer {
   public:
-    DeadConsumer(bool includeTemplateMethods, FileList ignored)
-      : templatesAlso(includeTemplateMethods), blacklist(ignored) { }
+    DeadConsumer(const AnalysisOptions &opts, CostModel *m)
+      : options(opts), costs(m), embedsFacts(false) { }
+
+    // where the FactEmbedder leaves the counters of the facts, to be printed
+    // along with the phases of the analysis
+    PerfSample *FactCounters() {
+      embedsFacts = true;
+      return &factCounters;
+    }
 
-    virtual void HandleTranslationUnit(ASTContext &ctx) {
-      MethodSet unusedPrivateMethods;
-      ClassSet undefinedClasses;
-      TranslationUnitDecl *tuDecl = ctx.getTranslationUnitDecl();
+    // kick off the analysis early (used in background mode, before code
+    // generation consumes the translation unit)
+    void StartAnalysis(ASTContext &ctx) {
+      analysis.Start(ctx, options);
+    }
 
-      // gather lists of:
-      //  - not fully defined classes
-      //  - all the private methods
-      DeclCollector collector(ctx, undefinedClasses, unusedPrivateMethods,
-          templatesAlso, blacklist);
-      collector.TraverseDecl(tuDecl);
+    virtual void HandleTranslationUnit(ASTContext &ctx) {
+      if (!analysis.WasStarted())
+        analysis.RunHere(ctx, options);
+      AnalysisResult result;
+      analysis.Finish(result);
+
+      WarnUnused(ctx.getDiagnostics(), result.findings());
+      ShowAdvice(ctx, result.advice());
+      ShowLayouts(ctx.getDiagnostics(), result.layouts());
+      if (!result.counters().empty())
+        PrintCounters(ctx, result.counters());
+    }
+  private:
+    typedef std::pair<double, const CXXMethodDecl *> CostedMethod;
+
+    AnalysisOptions options;
+    BackgroundAnalysis analysis;
+    CostModel *costs;
+    bool embedsFacts;
+    PerfSample factCounters;
+
+    // print warnings "unused ..."; when profiling, the costliest first, each
+    // with a note on its cost
+    void WarnUnused(DiagnosticsEngine &diags, llvm::ArrayRef<Finding> unused) {
+      if (!costs) {
+        for (unsigned i = 0, e = unused.size(); i != e; ++i)
+          MakeUnusedWarning(diags, unused[i].method);
+        return;
+      }
 
-      DeclRemover remover(unusedPrivateMethods);
-      remover.TraverseDecl(tuDecl);
+      std::vector<CostedMethod> ranked;
+      for (unsigned i = 0, e = unused.size(); i != e; ++i)
+        ranked.push_back(CostedMethod(costs->Cost(unused[i].method),
+              unused[i].method));
+      std::stable_sort(ranked.begin(), ranked.end(), MoreCostly);
+      for (unsigned i = 0, e = ranked.size(); i != e; ++i) {
+        MakeUnusedWarning(diags, ranked[i].second);
+        MakeCostNote(diags, ranked[i].second, ranked[i].first);
+      }
+    }
 
-      WarnUnused(ctx, undefinedClasses, unusedPrivateMethods);
+    // print warnings on signatures that could be slimmer
+    void ShowAdvice(ASTContext &ctx, llvm::ArrayRef<Advice> advice) {
+      for (unsigned i = 0, e = advice.size(); i != e; ++i)
+        MakeAdviceWarning(ctx, advice[i]);
     }
-  private:
-    // whether user shall be informed about (possibly) unused templated methods
-    bool templatesAlso;
-    // sorted list of file paths that should be ignored when warning about
-    // unused methods
-    FileList blacklist;
-    // print warnings "unused ..."
-    void WarnUnused(ASTContext &ctx, ClassSet &undefined, MethodSet &unused) {
+
+    void MakeAdviceWarning(ASTContext &ctx, const Advice &a) {
       DiagnosticsEngine &diags = ctx.getDiagnostics();
+      const std::string method = a.method->getQualifiedNameAsString();
+      switch (a.kind) {
+        case AK_UnreadParameter: {
+          unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Warning,
+              "parameter %0 of private method %1 is never read; its %2 "
+              "callers could stop passing it");
+          diags.Report(a.param->getLocation(), diagId) << ParamName(a.param)
+            << method << a.calls;
+          break;
+        }
+        case AK_DiscardedResult: {
+          unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Warning,
+              "all %0 callers of private method %1 discard its result; it "
+              "could return void");
+          diags.Report(a.method->getLocation(), diagId) << a.calls << method;
+          break;
+        }
+        case AK_NoThis: {
+          unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Warning,
+              "private method %0 does not use 'this'; it could be static");
+          diags.Report(a.method->getLocation(), diagId) << method;
+          break;
+        }
+        case AK_ConstantArgument: {
+          unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Warning,
+              "all %0 callers of private method %1 pass %2 for parameter "
+              "%3; it could be folded into the body");
+          Expr::EvalResult r;
+          a.argument->EvaluateAsRValue(r, ctx);
+          diags.Report(a.param->getLocation(), diagId) << a.calls << method
+            << r.Val.getAsString(ctx, a.param->getType())
+            << ParamName(a.param);
+          break;
+        }
+        case AK_CopiedParameter: {
+          unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Warning,
+              "private method %0 takes %1 (%2 bytes) by value in parameter "
+              "%3 and never modifies it; %4 of %5 calls copy an lvalue, "
+              "%select{pass it by const reference|pass it by const reference "
+              "with a && overload|pass it by rvalue reference}6");
+          const QualType t = a.param->getType();
+          const unsigned rvalues = a.calls - a.lvalueArgs;
+          diags.Report(a.param->getLocation(), diagId) << method << t
+            << unsigned(ctx.getTypeSizeInChars(t).getQuantity())
+            << ParamName(a.param) << a.lvalueArgs << a.calls
+            << (!rvalues ? 0 : a.lvalueArgs ? 1 : 2);
+          break;
+        }
+      }
+    }
 
-      for (MethodSet::iterator I = unused.begin(), E = unused.end();
-          I != E; ++I) {
-        const CXXMethodDecl *m = *I;
+    // print the proposed field orders, with a note per field
+    void ShowLayouts(DiagnosticsEngine &diags,
+        llvm::ArrayRef<LayoutAdvice> layouts) {
+      for (unsigned i = 0, e = layouts.size(); i != e; ++i) {
+        const LayoutAdvice &a = layouts[i];
+        unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Warning,
+            "%0 takes %1 bytes and its hot fields touch %2 cache lines; in "
+            "the order noted it would take %3 bytes and they %4");
+        diags.Report(a.record->getLocation(), diagId)
+          << a.record->getQualifiedNameAsString() << unsigned(a.size)
+          << a.lines << unsigned(a.newSize) << a.newLines;
+        if (a.splitSize) {
+          diagId = diags.getCustomDiagID(DiagnosticsEngine::Note,
+              "moving the %0 cold fields to an object of their own behind a "
+              "pointer would leave %1 bytes");
+          diags.Report(a.record->getLocation(), diagId)
+            << unsigned(a.order.size() - a.hot) << unsigned(a.splitSize);
+        }
+        diagId = diags.getCustomDiagID(DiagnosticsEngine::Note,
+            "field %0 goes %1, %select{hot|cold}2 with %3 accesses");
+        for (unsigned j = 0, je = a.order.size(); j != je; ++j)
+          diags.Report(a.order[j]->getLocation(), diagId)
+            << a.order[j]->getNameAsString() << (j ? "next" : "first")
+            << (j < a.hot ? 0 : 1) << llvm::utostr(a.weights[j]);
+      }
+    }
 
-        // care only about fully defined classes
-        if (!IsDefined(ctx, undefined, m->getParent()))
-          continue;
+    static std::string ParamName(const ParmVarDecl *p) {
+      const std::string name = p->getNameAsString();
+      if (!name.empty())
+        return name;
+      return "#" + llvm::utostr(p->getFunctionScopeIndex() + 1);
+    }
 
-        // some people declare private never used ctors/dtors purposefully
-        if (dyn_cast<CXXConstructorDecl>(m) || dyn_cast<CXXDestructorDecl>(m))
-          continue;
-        
-        MakeUnusedWarning(diags, m);
+    // One line per phase (with embed-facts, "facts" for the collection of
+    // the facts) and one for their sum, for dead-method-wp perf-totals to
+    // add up over a build:
+    //   dead-method perf: <phase> cycles=<n> ... <main file>
+    // Counters not available are printed as '-'.
+    void PrintCounters(ASTContext &ctx, llvm::ArrayRef<PerfSample> counters) {
+      static const char *const phases[AP_NumPhases] = {
+        "collect", "usage", "resolve"
+      };
+      const SourceManager &srcManager = ctx.getSourceManager();
+      const FileEntry *main =
+        srcManager.getFileEntryForID(srcManager.getMainFileID());
+      const char *tu = main ? main->getName() : "<stdin>";
+
+      PerfSample total;
+      for (unsigned i = 0, e = counters.size(); i != e; ++i) {
+        PrintSample(phases[i], counters[i], tu);
+        total.Add(counters[i]);
       }
+      if (embedsFacts) {
+        PrintSample("facts", factCounters, tu);
+        total.Add(factCounters);
+      }
+      PrintSample("total", total, tu);
     }
 
-    // if the class is defined and its friend functions/friend classes' methods
-    // are all defined
-    bool IsDefined(ASTContext &ctx, ClassSet &undefined,
-        const CXXRecordDecl *r) {
-      if (Contains(ctx, undefined, ctx.getRecordType(r)))
-        return false;
+    void PrintSample(const char *phase, const PerfSample &s, const char *tu) {
+      llvm::raw_ostream &os = llvm::errs();
+      os << "dead-method perf: " << llvm::format("%-8s", phase);
+      for (unsigned i = 0; i != PE_NumEvents; ++i) {
+        os << " " << PerfEventNames[i] << "=";
+        if (s.valid[i])
+          os << s.counts[i];
+        else
+          os << "-";
+      }
+      os << " " << tu << "\n";
+    }
 
-      // whether all friends are defined
-      for (CXXRecordDecl::friend_iterator I = r->friend_begin(),
-          E = r->friend_end(); I != E; ++I) {
-        // it may be a function...
-        const NamedDecl *fDecl = (*I)->getFriendDecl();
-        const FunctionDecl *fFun = dyn_cast_or_null<FunctionDecl>(fDecl);
-        if (fFun) {
-          if (!fFun->getCanonicalDecl()->isDefined())
-            return false;
-        }
+    static bool MoreCostly(const CostedMethod &a, const CostedMethod &b) {
+      return a.first > b.first;
+    }
 
-        // ...or a type
-        const TypeSourceInfo *fInfo = (*I)->getFriendType();
-        if (fInfo) {
-          if (Contains(ctx, undefined,  fInfo->getType()))
-            return false;
-        }
+    void MakeCostNote(DiagnosticsEngine &diags, const CXXMethodDecl *m,
+        double seconds) {
+      const FunctionDecl *def;
+      if (!m->isDefined(def) || !m->getASTContext().DeclMustBeEmitted(def)) {
+        unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Note,
+            "no code is generated for it in this translation unit, its "
+            "definition only costs parsing");
+        diags.Report(m->getLocation(), diagId);
+        return;
       }
-      // nothing suspicious found
-      return true;
+      std::string cost;
+      llvm::raw_string_ostream os(cost);
+      os << llvm::format("%.3f", seconds * 1e3);
+      unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Note,
+          "generating code for it takes %0 ms in this translation unit");
+      diags.Report(m->getLocation(), diagId) << os.str();
     }
 
     void MakeUnusedWarning(DiagnosticsEngine &diags, const CXXMethodDecl *m) {
@@ -218,32 +343,130 @@ class DeadConsumer : public ASTConsumer {
     }
 };
 
+// sits in front of the code generator and hands the translation unit over to
+// the background analysis before the backend starts
+class AnalysisStarter : public ASTConsumer {
+  public:
+    AnalysisStarter(DeadConsumer *c) : dead(c) { }
+
+    virtual void HandleTranslationUnit(ASTContext &ctx) {
+      dead->StartAnalysis(ctx);
+    }
+  private:
+    DeadConsumer *dead;
+};
+
+// clang's -emit-obj action with its consumer factory made reachable
+class ObjectEmitter : public EmitObjAction {
+  public:
+    using EmitObjAction::CreateASTConsumer;
+};
+
 // main plugin action
 class DeadAction : public PluginASTAction {
   protected:
-    ASTConsumer *CreateASTConsumer(CompilerInstance &, StringRef) {
-      return new DeadConsumer(includeTemplateMethods, blacklist);
+    ASTConsumer *CreateASTConsumer(CompilerInstance &ci, StringRef inFile) {
+      AnalysisOptions opts;
+      opts.includeTemplateMethods = includeTemplateMethods;
+      opts.ignoredFiles = blacklist;
+      opts.adviseSignatures = adviseSignatures;
+      opts.adviseConstantArgs = adviseConstantArgs;
+      opts.adviseCopies = adviseCopies;
+      opts.perfCounters = perfCounters;
+      opts.adviseLayout = adviseLayout;
+      opts.methodWeights = layoutProfile;
+      if (profileCost)
+        costs.reset(new CodeGenCost(ci));
+      DeadConsumer *dead = new DeadConsumer(opts, costs.get());
+      if (!background && !embedFacts)
+        return dead;
+
+      // We replace the main action, so emit the object file ourselves: embed
+      // the facts and start the analysis before the code generator, report
+      // after the backend.
+      emitter.reset(new ObjectEmitter);
+      ASTConsumer *codeGen = emitter->CreateASTConsumer(ci, inFile);
+      if (!codeGen) {
+        delete dead;
+        return 0;
+      }
+      std::vector<ASTConsumer *> consumers;
+      if (embedFacts)
+        consumers.push_back(new FactEmbedder(codeGen, costs.get(),
+              perfCounters ? dead->FactCounters() : 0));
+      if (background)
+        consumers.push_back(new AnalysisStarter(dead));
+      consumers.push_back(codeGen);
+      consumers.push_back(dead);
+      return new MultiplexConsumer(consumers);
     }
 
     bool ParseArgs(const CompilerInstance &ci,
         const std::vector<std::string> &args) {
       includeTemplateMethods = false;
+      background = false;
+      embedFacts = false;
+      profileCost = false;
+      adviseSignatures = false;
+      adviseConstantArgs = false;
+      adviseCopies = false;
+      perfCounters = false;
+      adviseLayout = false;
+      layoutProfile.clear();
       bool showHelp = false;
 
       DiagnosticsEngine &diags = ci.getDiagnostics();
       for (unsigned i = 0, e = args.size(); i != e; ++i)
         if (args[i] == "include-template-methods")
           includeTemplateMethods = true;
+        else if (args[i] == "background")
+          background = true;
+        else if (args[i] == "embed-facts")
+          embedFacts = true;
+        else if (args[i] == "profile-cost")
+          profileCost = true;
+        else if (args[i] == "advise-signatures")
+          adviseSignatures = true;
+        else if (args[i] == "advise-constant-args")
+          adviseConstantArgs = true;
+        else if (args[i] == "advise-copies")
+          adviseCopies = true;
+        else if (args[i] == "perf-counters")
+          perfCounters = true;
+        else if (args[i] == "advise-layout")
+          adviseLayout = true;
         else if (args[i] == "help")
           showHelp = true;
         else if (args[i] == "ignore" && i + 1 != e) {
           ++i;
           blacklist.push_back(args[i]);
+        } else if (args[i] == "layout-profile" && i + 1 != e) {
+          ++i;
+          adviseLayout = true;
+          if (!LoadProfile(diags, args[i]))
+            return false;
         } else {
           MakeArgumentError(diags, args[i]);
           return false;
         }
 
+      // the code generator is only ours to drive when we are the main action
+      const FrontendOptions &opts = ci.getFrontendOpts();
+      if ((background || embedFacts) &&
+          (opts.ProgramAction != frontend::PluginAction ||
+           opts.ActionName != "dead-method")) {
+        MakeUsageError(diags, "'background' and 'embed-facts' require "
+            "-plugin dead-method instead of -add-plugin");
+        return false;
+      }
+
+      const llvm::Triple triple(ci.getTargetOpts().Triple);
+      if (embedFacts && (triple.isOSDarwin() ||
+            triple.getOS() == llvm::Triple::Win32 || triple.isOSCygMing())) {
+        MakeUsageError(diags, "'embed-facts' requires an ELF target");
+        return false;
+      }
+
       if (showHelp)
         ShowHelp();
       std::sort(blacklist.begin(), blacklist.end());
@@ -252,7 +475,27 @@ class DeadAction : public PluginASTAction {
     }
   private:
     bool includeTemplateMethods;
+    // run the analysis concurrently with emitting the object file
+    bool background;
+    // put the facts for the whole-program driver into the object file
+    bool embedFacts;
+    // measure what the unused methods cost to compile
+    bool profileCost;
+    // report private methods whose signature could be slimmer
+    bool adviseSignatures;
+    // report parameters that always get the same constant
+    bool adviseConstantArgs;
+    // report expensive parameters taken by value and never modified
+    bool adviseCopies;
+    // print hardware performance counters of the analysis phases
+    bool perfCounters;
+    // propose field orders for closed classes
+    bool adviseLayout;
+    // weights of the methods for adviseLayout
+    std::map<std::string, uint64_t> layoutProfile;
     FileList blacklist;
+    llvm::OwningPtr<ObjectEmitter> emitter;
+    llvm::OwningPtr<CodeGenCost> costs;
 
     void MakeArgumentError(DiagnosticsEngine &diags, std::string arg) {
       unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Error,
@@ -260,12 +503,68 @@ class DeadAction : public PluginASTAction {
       diags.Report(diagId);
     }
 
+    void MakeUsageError(DiagnosticsEngine &diags, StringRef msg) {
+      unsigned diagId = diags.getCustomDiagID(DiagnosticsEngine::Error, msg);
+      diags.Report(diagId);
+    }
+
+    // a line "<count> <qualified method name>" per method, e.g. samples
+    // from a profiler; the counts of a method listed twice add up
+    bool LoadProfile(DiagnosticsEngine &diags, const std::string &file) {
+      llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+      if (llvm::error_code ec = llvm::MemoryBuffer::getFile(file, buffer)) {
+        MakeUsageError(diags, "cannot read '" + file + "': " + ec.message());
+        return false;
+      }
+
+      SmallVector<StringRef, 64> lines;
+      buffer->getBuffer().split(lines, "\n");
+      for (unsigned i = 0, e = lines.size(); i != e; ++i) {
+        const std::pair<StringRef, StringRef> line =
+          lines[i].trim().split(' ');
+        uint64_t count;
+        if (line.first.empty())
+          continue;
+        if (line.first.getAsInteger(10, count) || line.second.trim().empty()) {
+          MakeUsageError(diags, file + ":" + llvm::utostr(i + 1) +
+              ": expected '<count> <method>'");
+          return false;
+        }
+        layoutProfile[line.second.trim().str()] += count;
+      }
+      return true;
+    }
+
     void ShowHelp() {
       llvm::errs() << "DeadMethod plugin: warn if fully defined classes "
         "with unused private methods found\n"
         "Available arguments:\n"
         "  help                      print this message\n"
-        "  include-template-methods  look for template methods as well\n";
+        "  include-template-methods  look for template methods as well\n"
+        "  background                analyse while emitting the object file\n"
+        "                            (use with -plugin, not -add-plugin)\n"
+        "  embed-facts               store the facts for dead-method-wp in\n"
+        "                            the .deadmethod section of the object\n"
+        "                            (use with -plugin, not -add-plugin)\n"
+        "  profile-cost              rank the unused methods by the time it\n"
+        "                            takes to generate code for them (also\n"
+        "                            recorded by embed-facts)\n"
+        "  advise-signatures         warn about unread parameters, results\n"
+        "                            all callers discard and methods not\n"
+        "                            using 'this' (closed classes only)\n"
+        "  advise-constant-args      warn about parameters of private\n"
+        "                            methods that get the same constant at\n"
+        "                            every call (closed classes only)\n"
+        "  advise-copies             warn about expensive parameters of\n"
+        "                            private methods taken by value and\n"
+        "                            never modified (closed classes only)\n"
+        "  perf-counters             print cycles, instructions, cache and\n"
+        "                            branch misses of each analysis phase\n"
+        "                            (Linux)\n"
+        "  advise-layout             propose field orders that put the hot\n"
+        "                            fields of closed classes together\n"
+        "  layout-profile <file>     advise-layout, weighing the accesses by\n"
+        "                            the counts of '<count> <method>' lines\n";
     }
 };
 }
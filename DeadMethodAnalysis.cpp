@@ -0,0 +1,1266 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// The analysis behind the plugin: collection of private methods and not fully
+// defined classes, removal of the referenced methods and the per translation
+// unit closure; the scan of how private methods are called and private fields
+// accessed, for the advice.
+//
+#include "DeadMethodAnalysis.h"
+#include "DeadFacts.h"
+#include "clang/AST/AST.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/ParentMap.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace deadmethod;
+
+namespace {
+
+typedef llvm::DenseSet<const CXXMethodDecl *> MethodSet;
+typedef llvm::DenseSet<const Type *> ClassSet;
+
+const uint64_t CacheLineBytes = 64;
+
+// set manipulation functions
+bool Contains(ASTContext &ctx, const ClassSet &set, const QualType elt) {
+  const Type *t = ctx.getCanonicalType(elt).getTypePtrOrNull();
+  if (!t)
+    return false;
+  return set.find(t) != set.end();
+}
+
+void Insert(ASTContext &ctx, ClassSet &set, const QualType elt) {
+  const Type *t = ctx.getCanonicalType(elt).getTypePtrOrNull();
+  if (t)
+    set.insert(t);
+}
+
+// equality of the scalar values constant arguments evaluate to: integers
+// (bool, enumerators), floating point and pointers to the same object or
+// to equal string literals
+bool SameValue(const APValue &a, const APValue &b) {
+  if (a.isInt() && b.isInt())
+    return a.getInt() == b.getInt();
+  if (a.isFloat() && b.isFloat())
+    return a.getFloat().bitwiseIsEqual(b.getFloat());
+  if (!a.isLValue() || !b.isLValue() ||
+      a.getLValueOffset() != b.getLValueOffset())
+    return false;
+
+  // the same object or function, or both null
+  const APValue::LValueBase baseA = a.getLValueBase();
+  const APValue::LValueBase baseB = b.getLValueBase();
+  if (baseA == baseB)
+    return true;
+  const StringLiteral *strA =
+    dyn_cast_or_null<StringLiteral>(baseA.dyn_cast<const Expr *>());
+  const StringLiteral *strB =
+    dyn_cast_or_null<StringLiteral>(baseB.dyn_cast<const Expr *>());
+  return strA && strB && strA->getBytes() == strB->getBytes();
+}
+
+// look through the temporaries and conversions of a full expression
+Expr *IgnoreTemporaries(Expr *e) {
+  for (;;) {
+    e = e->IgnoreParenImpCasts();
+    if (ExprWithCleanups *c = dyn_cast<ExprWithCleanups>(e))
+      e = c->getSubExpr();
+    else if (CXXBindTemporaryExpr *t = dyn_cast<CXXBindTemporaryExpr>(e))
+      e = t->getSubExpr();
+    else if (MaterializeTemporaryExpr *m =
+        dyn_cast<MaterializeTemporaryExpr>(e))
+      e = m->GetTemporaryExpr();
+    else
+      return e;
+  }
+}
+
+// Lays the fields out in the given order from 'start' the way plain (not
+// bit-field, not packed) fields are; the offsets and the end are in bytes.
+uint64_t LayOut(ASTContext &ctx, const std::vector<const FieldDecl *> &fields,
+    uint64_t start, std::vector<uint64_t> &offsets) {
+  uint64_t offset = start;
+  offsets.clear();
+  for (unsigned i = 0, e = fields.size(); i != e; ++i) {
+    offset = llvm::RoundUpToAlignment(offset,
+        ctx.getDeclAlign(fields[i]).getQuantity());
+    offsets.push_back(offset);
+    offset += ctx.getTypeSizeInChars(fields[i]->getType()).getQuantity();
+  }
+  return offset;
+}
+
+// cache lines the first 'n' fields touch at the given offsets
+unsigned CacheLines(ASTContext &ctx,
+    const std::vector<const FieldDecl *> &fields,
+    const std::vector<uint64_t> &offsets, unsigned n) {
+  std::vector<uint64_t> lines;
+  for (unsigned i = 0; i != n; ++i) {
+    const uint64_t size =
+      ctx.getTypeSizeInChars(fields[i]->getType()).getQuantity();
+    for (uint64_t l = offsets[i] / CacheLineBytes,
+        e = (offsets[i] + std::max<uint64_t>(size, 1) - 1) / CacheLineBytes;
+        l <= e; ++l)
+      lines.push_back(l);
+  }
+  std::sort(lines.begin(), lines.end());
+  return std::unique(lines.begin(), lines.end()) - lines.begin();
+}
+
+// orders field indices by decreasing weight
+struct Heavier {
+  const std::vector<uint64_t> &weights;
+  Heavier(const std::vector<uint64_t> &w) : weights(w) { }
+  bool operator()(unsigned a, unsigned b) const {
+    return weights[a] > weights[b];
+  }
+};
+
+// orders fields by decreasing alignment, which packs them tightest
+struct MoreAligned {
+  ASTContext &ctx;
+  MoreAligned(ASTContext &c) : ctx(c) { }
+  bool operator()(const FieldDecl *a, const FieldDecl *b) const {
+    return ctx.getDeclAlign(a) > ctx.getDeclAlign(b);
+  }
+};
+
+// references to given parameters in a body
+class ParamRefCollector : public RecursiveASTVisitor<ParamRefCollector> {
+  public:
+    ParamRefCollector(const ParmVarDecl *p) : param(p) { }
+
+    bool VisitDeclRefExpr(DeclRefExpr *e) {
+      if (e->getDecl() == param)
+        refs.push_back(e);
+      return true;
+    }
+
+    std::vector<const DeclRefExpr *> refs;
+  private:
+    const ParmVarDecl *param;
+};
+
+// mark off the used methods
+class DeclRemover : public RecursiveASTVisitor<DeclRemover> {
+  public:
+    DeclRemover(MethodSet &privateOnes) : unused(privateOnes) { }
+
+    bool VisitMemberExpr(MemberExpr *e) {
+      const ValueDecl *d = e->getMemberDecl();
+      FlagMethodUsed(dyn_cast_or_null<CXXMethodDecl>(d));
+      return true;
+    }
+
+    bool VisitDeclRefExpr(DeclRefExpr *e) {
+      FlagMethodUsed(dyn_cast_or_null<CXXMethodDecl>(e->getDecl()));
+      return true;
+    }
+
+  private:
+    MethodSet &unused;
+
+    // remove the method from the unused methods set; ignore NULL silently
+    void FlagMethodUsed(const CXXMethodDecl *m) {
+      if (!m || !(m = m->getCanonicalDecl()))
+        return;
+
+      unused.erase(m);
+    }
+};
+
+// gather:
+//  - classes with undefined methods
+//  - declared private methods
+class DeclCollector : public RecursiveASTVisitor<DeclCollector> {
+  public:
+    DeclCollector(ASTContext &c, ClassSet &u, MethodSet &p, bool t)
+      : ctx(c), undefinedClasses(u), privateMethods(p), templates(t) { }
+
+    bool VisitCXXMethodDecl(CXXMethodDecl *m) {
+      const CXXRecordDecl *r;
+      m = m->getCanonicalDecl();
+      if (!m || !(r = m->getParent()) || !(r = r->getCanonicalDecl()))
+        return true;
+
+      if (!m->isDefined())
+        MarkUndefined(r);
+
+      // only private methods are concerned
+      if (m->getAccess() != AS_private)
+        return true;
+
+      // omit template methods if flag on
+      if (IsTemplated(m) && !templates)
+        return true;
+
+      privateMethods.insert(m);
+
+      return true;
+    }
+
+    bool VisitCXXRecordDecl(CXXRecordDecl *r) {
+      r = r->getCanonicalDecl();
+      if (r && !r->hasDefinition())
+        MarkUndefined(r);
+
+      return true;
+    }
+  private:
+    ASTContext &ctx;
+    ClassSet &undefinedClasses;
+    MethodSet &privateMethods;
+    bool templates;
+
+    void MarkUndefined(const CXXRecordDecl *r) {
+      Insert(ctx, undefinedClasses, ctx.getRecordType(r));
+    }
+
+    bool IsTemplated(const CXXMethodDecl *m) {
+      if (m->getDescribedFunctionTemplate())
+        return true;
+      return false;
+    }
+};
+
+// Counts what needs the vtables: virtual method calls that dispatch through
+// them, member pointers to virtual methods and the other uses (dynamic_cast,
+// typeid, delete through a base). Unlike the other scans it looks into
+// template instantiations too: std::unique_ptr<Base> deletes through Base
+// in std::default_delete<Base>::operator().
+class DispatchScan : public RecursiveASTVisitor<DispatchScan> {
+  public:
+    typedef llvm::DenseMap<const CXXMethodDecl *, unsigned> RefMap;
+
+    // by the canonical declarations
+    RefMap virtualRefs;
+    llvm::DenseSet<const CXXRecordDecl *> dynamicUses;
+
+    bool shouldVisitTemplateInstantiations() const { return true; }
+
+    // calls of virtual methods not qualified and not on an object whose
+    // type is known go through the vtable
+    bool VisitCXXMemberCallExpr(CXXMemberCallExpr *e) {
+      const MemberExpr *callee =
+        dyn_cast<MemberExpr>(e->getCallee()->IgnoreParens());
+      if (callee && !callee->hasQualifier() &&
+          (callee->isArrow() || !IsExactObject(callee->getBase())))
+        CountVirtual(dyn_cast<CXXMethodDecl>(callee->getMemberDecl()));
+      return true;
+    }
+
+    bool VisitCXXOperatorCallExpr(CXXOperatorCallExpr *e) {
+      const CXXMethodDecl *m =
+        dyn_cast_or_null<CXXMethodDecl>(e->getDirectCallee());
+      if (m && e->getNumArgs() && !IsExactObject(e->getArg(0)))
+        CountVirtual(m);
+      return true;
+    }
+
+    bool VisitUnaryOperator(UnaryOperator *e) {
+      const DeclRefExpr *ref = e->getOpcode() == UO_AddrOf ?
+        dyn_cast<DeclRefExpr>(e->getSubExpr()->IgnoreParens()) : 0;
+      if (ref)
+        CountVirtual(dyn_cast<CXXMethodDecl>(ref->getDecl()));
+      return true;
+    }
+
+    bool VisitCXXDeleteExpr(CXXDeleteExpr *e) {
+      const CXXRecordDecl *r = e->getDestroyedType()->getAsCXXRecordDecl();
+      const CXXDestructorDecl *d =
+        r && r->hasDefinition() ? r->getDefinition()->getDestructor() : 0;
+      if (d && d->isVirtual())
+        DynamicUse(r);
+      return true;
+    }
+
+    bool VisitCXXDynamicCastExpr(CXXDynamicCastExpr *e) {
+      QualType t = e->getSubExpr()->getType();
+      if (const PointerType *p = t->getAs<PointerType>())
+        t = p->getPointeeType();
+      DynamicUse(t->getAsCXXRecordDecl());
+      return true;
+    }
+
+    bool VisitCXXTypeidExpr(CXXTypeidExpr *e) {
+      if (!e->isTypeOperand())
+        DynamicUse(e->getExprOperand()->getType()->getAsCXXRecordDecl());
+      return true;
+    }
+  private:
+    void CountVirtual(const CXXMethodDecl *m) {
+      if (m && m->isVirtual() && (m = m->getCanonicalDecl()))
+        ++virtualRefs[m];
+    }
+
+    void DynamicUse(const CXXRecordDecl *r) {
+      if (r && r->hasDefinition() && r->getDefinition()->isDynamicClass())
+        dynamicUses.insert(r->getCanonicalDecl());
+    }
+
+    // whether the dynamic type of the object is its static type: a
+    // variable or field of class type, or a temporary
+    static bool IsExactObject(const Expr *e) {
+      e = e->IgnoreParenImpCasts();
+      if (const DeclRefExpr *ref = dyn_cast<DeclRefExpr>(e))
+        return !ref->getDecl()->getType()->isReferenceType();
+      if (const MemberExpr *m = dyn_cast<MemberExpr>(e))
+        return isa<FieldDecl>(m->getMemberDecl()) &&
+          !m->getMemberDecl()->getType()->isReferenceType();
+      return isa<MaterializeTemporaryExpr>(e) || isa<CXXConstructExpr>(e) ||
+        isa<CXXBindTemporaryExpr>(e);
+    }
+};
+
+// Records the facts the whole-program driver needs: every class and method,
+// definitions of friends, the number of references to each method and of
+// those that dispatch through the vtable (see DispatchScan), and the vtables
+// of the classes. Keys are qualified names (plus the type for functions),
+// prefixed with the main file for entities without external linkage
+// (anonymous namespaces, local classes and the members of both), which other
+// translation units may name alike.
+class FactCollector : public RecursiveASTVisitor<FactCollector> {
+  public:
+    FactCollector(ASTContext &c, deadfacts::TUFacts &f, CostModel *m)
+      : ctx(c), facts(f), costs(m) {
+      const SourceManager &srcManager = ctx.getSourceManager();
+      const FileEntry *main =
+        srcManager.getFileEntryForID(srcManager.getMainFileID());
+      if (!main) {
+        facts.tu = "<stdin>";
+        return;
+      }
+      // the name as spelled is relative to the directory of the compile
+      // command, which the driver does not share
+      llvm::SmallString<256> path(main->getName());
+      llvm::sys::fs::make_absolute(path);
+      facts.tu = path.str();
+    }
+
+    bool VisitCXXRecordDecl(CXXRecordDecl *r) {
+      r = r->getCanonicalDecl();
+      if (!r || !seenClasses.insert(r).second)
+        return true;
+
+      deadfacts::ClassFact c;
+      c.key = Key(r);
+      c.name = r->getQualifiedNameAsString();
+      // members of nested classes have access to the private ones
+      if (const CXXRecordDecl *outer =
+          dyn_cast<CXXRecordDecl>(r->getDeclContext()))
+        c.outer = Key(outer->getCanonicalDecl());
+      const CXXRecordDecl *def = r->getDefinition();
+      c.defined = def != 0;
+      if (def)
+        for (CXXRecordDecl::friend_iterator I = def->friend_begin(),
+            E = def->friend_end(); I != E; ++I) {
+          const FunctionDecl *fFun =
+            dyn_cast_or_null<FunctionDecl>((*I)->getFriendDecl());
+          if (fFun) {
+            fFun = fFun->getCanonicalDecl();
+            c.friendFunctions.push_back(Key(fFun));
+            deadfacts::FunctionFact f;
+            f.key = c.friendFunctions.back();
+            f.defined = fFun->isDefined();
+            facts.functions.push_back(f);
+          }
+          const TypeSourceInfo *fInfo = (*I)->getFriendType();
+          const CXXRecordDecl *fClass =
+            fInfo ? fInfo->getType()->getAsCXXRecordDecl() : 0;
+          if (fClass)
+            c.friendClasses.push_back(Key(fClass->getCanonicalDecl()));
+        }
+      if (def) {
+        for (CXXRecordDecl::base_class_const_iterator I = def->bases_begin(),
+            E = def->bases_end(); I != E; ++I)
+          if (const CXXRecordDecl *b = I->getType()->getAsCXXRecordDecl())
+            c.bases.push_back(Key(b->getCanonicalDecl()));
+        if (def->isDynamicClass() &&
+            (def->getNumVBases() || def->isDependentContext()))
+          c.vptrRequired = true;
+        else if (def->isDynamicClass()) {
+          const unsigned pointer =
+            ctx.getTargetInfo().getPointerWidth(0) / 8;
+          const unsigned vptrs = VPtrs(def);
+          c.vptrBytes = vptrs * pointer;
+          // offset to top and type info per vtable, then the slots
+          c.vtableBytes = (2 * vptrs + Slots(def)) * pointer;
+          if (!def->isInvalidDecl())
+            c.size = ctx.getASTRecordLayout(def).getSize().getQuantity();
+        }
+        PresumedLoc loc =
+          ctx.getSourceManager().getPresumedLoc(def->getLocation());
+        if (loc.isValid()) {
+          c.file = loc.getFilename();
+          c.line = loc.getLine();
+        }
+      }
+      facts.classes.push_back(c);
+      return true;
+    }
+
+    bool VisitCXXMethodDecl(CXXMethodDecl *m) {
+      const CXXRecordDecl *r;
+      m = m->getCanonicalDecl();
+      if (!m || !(r = m->getParent()) || !(r = r->getCanonicalDecl()))
+        return true;
+      if (!seenMethods.insert(m).second)
+        return true;
+
+      deadfacts::MethodFact f;
+      f.key = Key(m);
+      f.classKey = Key(r);
+      f.name = m->getQualifiedNameAsString();
+      PresumedLoc loc = ctx.getSourceManager().getPresumedLoc(m->getLocation());
+      if (loc.isValid()) {
+        f.file = loc.getFilename();
+        f.line = loc.getLine();
+      }
+      if (m->getAccess() == AS_private)
+        f.flags |= deadfacts::MF_Private;
+      if (m->isDefined())
+        f.flags |= deadfacts::MF_Defined;
+      if (isa<CXXConstructorDecl>(m) || isa<CXXDestructorDecl>(m))
+        f.flags |= deadfacts::MF_Structor;
+      if (isa<CXXDestructorDecl>(m))
+        f.flags |= deadfacts::MF_Destructor;
+      if (m->getDescribedFunctionTemplate())
+        f.flags |= deadfacts::MF_Templated;
+      if (m->isDependentContext())
+        f.flags |= deadfacts::MF_Dependent;
+      if (m->getLinkage() == ExternalLinkage &&
+          m->getVisibility() == DefaultVisibility)
+        f.flags |= deadfacts::MF_Exported;
+      if (m->isVirtual())
+        f.flags |= deadfacts::MF_Virtual;
+      if (m->isPure())
+        f.flags |= deadfacts::MF_Pure;
+      facts.methods.push_back(f);
+      methodDecls.push_back(m);
+      return true;
+    }
+
+    bool VisitMemberExpr(MemberExpr *e) {
+      CountRef(dyn_cast_or_null<CXXMethodDecl>(e->getMemberDecl()));
+      return true;
+    }
+
+    bool VisitDeclRefExpr(DeclRefExpr *e) {
+      CountRef(dyn_cast_or_null<CXXMethodDecl>(e->getDecl()));
+      return true;
+    }
+
+    // constructors are called without naming them
+    bool VisitCXXConstructExpr(CXXConstructExpr *e) {
+      CountRef(e->getConstructor());
+      return true;
+    }
+
+    // move the reference counts over to the facts and measure the methods
+    // that may turn out dead; call after traversing
+    void Finish(const DispatchScan &dispatch) {
+      const unsigned candidate = deadfacts::MF_Private | deadfacts::MF_Defined;
+      for (unsigned i = 0, e = facts.methods.size(); costs && i != e; ++i) {
+        deadfacts::MethodFact &f = facts.methods[i];
+        if ((f.flags & (candidate | deadfacts::MF_Structor)) == candidate &&
+            !refs.count(methodDecls[i]))
+          f.cost = uint32_t(costs->Cost(methodDecls[i]) * 1e6);
+      }
+      methodDecls.clear();
+
+      // dispatches from template instantiations may name methods nothing
+      // else refers to
+      for (RefMap::const_iterator I = dispatch.virtualRefs.begin(),
+          E = dispatch.virtualRefs.end(); I != E; ++I)
+        refs[I->first] = std::max(refs[I->first], I->second);
+      for (RefMap::iterator I = refs.begin(), E = refs.end(); I != E; ++I) {
+        deadfacts::RefFact f;
+        f.key = Key(I->first);
+        f.count = I->second;
+        RefMap::const_iterator v = dispatch.virtualRefs.find(I->first);
+        if (v != dispatch.virtualRefs.end())
+          f.virtualCount = v->second;
+        facts.refs.push_back(f);
+      }
+      refs.clear();
+
+      for (llvm::DenseSet<const CXXRecordDecl *>::const_iterator
+          I = dispatch.dynamicUses.begin(), E = dispatch.dynamicUses.end();
+          I != E; ++I)
+        facts.dynamicUses.push_back(Key(*I));
+    }
+  private:
+    typedef DispatchScan::RefMap RefMap;
+
+    ASTContext &ctx;
+    deadfacts::TUFacts &facts;
+    CostModel *costs;
+    llvm::DenseSet<const CXXRecordDecl *> seenClasses;
+    MethodSet seenMethods;
+    // parallel to facts.methods
+    std::vector<const CXXMethodDecl *> methodDecls;
+    RefMap refs;
+
+    void CountRef(const CXXMethodDecl *m) {
+      if (m && (m = m->getCanonicalDecl()))
+        ++refs[m];
+    }
+
+    // vtable pointers in an object of a dynamic class: one, shared with the
+    // primary base, or those of its dynamic bases
+    static unsigned VPtrs(const CXXRecordDecl *r) {
+      unsigned n = 0;
+      for (CXXRecordDecl::base_class_const_iterator I = r->bases_begin(),
+          E = r->bases_end(); I != E; ++I) {
+        const CXXRecordDecl *b = I->getType()->getAsCXXRecordDecl();
+        if (b && (b = b->getDefinition()) && b->isDynamicClass())
+          n += VPtrs(b);
+      }
+      return n ? n : 1;
+    }
+
+    // vtable slots: those of the bases and one per virtual method that
+    // overrides none (two for the destructor, complete and deleting)
+    static unsigned Slots(const CXXRecordDecl *r) {
+      unsigned n = 0;
+      for (CXXRecordDecl::base_class_const_iterator I = r->bases_begin(),
+          E = r->bases_end(); I != E; ++I) {
+        const CXXRecordDecl *b = I->getType()->getAsCXXRecordDecl();
+        if (b && (b = b->getDefinition()) && b->isDynamicClass())
+          n += Slots(b);
+      }
+      for (CXXRecordDecl::method_iterator I = r->method_begin(),
+          E = r->method_end(); I != E; ++I)
+        if (I->isVirtual() && !I->size_overridden_methods())
+          n += isa<CXXDestructorDecl>(*I) ? 2 : 1;
+      return n;
+    }
+
+    std::string Key(const NamedDecl *d) {
+      std::string key;
+      if (d->getLinkage() != ExternalLinkage)
+        key = facts.tu + "$";
+      key += d->getQualifiedNameAsString();
+      if (const FunctionDecl *f = dyn_cast<FunctionDecl>(d))
+        key += "#" + f->getType().getCanonicalType().getAsString();
+      return key;
+    }
+};
+
+}
+
+namespace deadmethod {
+
+// Records how the private methods are used: the expressions naming them, the
+// calls among those and whether the caller drops the result; for the method
+// bodies, the parameters referred to and whether 'this' is; and which bodies
+// access which private fields.
+class UsageScan : public RecursiveASTVisitor<UsageScan> {
+  public:
+    struct Usage {
+      // expressions naming the method
+      unsigned refs;
+      // of those, direct calls
+      unsigned calls;
+      // calls whose value is dropped
+      unsigned discarded;
+      // named by a dependent expression, the calls are not known
+      bool opaque;
+      // the calls themselves, if asked to keep them
+      std::vector<const CallExpr *> sites;
+
+      Usage() : refs(0), calls(0), discarded(0), opaque(false) { }
+    };
+    typedef llvm::DenseMap<const CXXMethodDecl *, Usage> UsageMap;
+    // a field and the outermost method accessing it (0 outside of methods)
+    typedef std::pair<const FieldDecl *, const CXXMethodDecl *> FieldUse;
+    typedef llvm::DenseMap<FieldUse, unsigned> FieldUseMap;
+
+    UsageScan(bool keepCalls) : keepSites(keepCalls) { }
+
+    // keyed by the canonical declarations
+    UsageMap methods;
+    llvm::DenseSet<const ParmVarDecl *> referencedParams;
+    // definitions whose body refers to 'this'
+    llvm::DenseSet<const CXXMethodDecl *> usingThis;
+    // number of accesses
+    FieldUseMap fieldUses;
+
+    bool TraverseCXXMethodDecl(CXXMethodDecl *m) {
+      bodies.push_back(m);
+      const bool ok = RecursiveASTVisitor<UsageScan>::TraverseCXXMethodDecl(m);
+      bodies.pop_back();
+      return ok;
+    }
+
+    // each kind of method has its own traversal, bypassing the one above
+    bool TraverseCXXConstructorDecl(CXXConstructorDecl *m) {
+      bodies.push_back(m);
+      const bool ok =
+        RecursiveASTVisitor<UsageScan>::TraverseCXXConstructorDecl(m);
+      bodies.pop_back();
+      return ok;
+    }
+
+    bool TraverseCXXDestructorDecl(CXXDestructorDecl *m) {
+      bodies.push_back(m);
+      const bool ok =
+        RecursiveASTVisitor<UsageScan>::TraverseCXXDestructorDecl(m);
+      bodies.pop_back();
+      return ok;
+    }
+
+    bool TraverseCXXConversionDecl(CXXConversionDecl *m) {
+      bodies.push_back(m);
+      const bool ok =
+        RecursiveASTVisitor<UsageScan>::TraverseCXXConversionDecl(m);
+      bodies.pop_back();
+      return ok;
+    }
+
+    bool VisitCXXThisExpr(CXXThisExpr *) {
+      // a lambda's call operator borrows 'this' from the enclosing methods
+      usingThis.insert(bodies.begin(), bodies.end());
+      return true;
+    }
+
+    bool VisitDeclRefExpr(DeclRefExpr *e) {
+      if (const ParmVarDecl *p = dyn_cast<ParmVarDecl>(e->getDecl()))
+        referencedParams.insert(p);
+      Named(dyn_cast<CXXMethodDecl>(e->getDecl()));
+      return true;
+    }
+
+    bool VisitMemberExpr(MemberExpr *e) {
+      Named(dyn_cast<CXXMethodDecl>(e->getMemberDecl()));
+      const FieldDecl *f = dyn_cast<FieldDecl>(e->getMemberDecl());
+      if (f && f->getAccess() == AS_private)
+        ++fieldUses[FieldUse(f, bodies.empty() ? 0 : bodies.front())];
+      return true;
+    }
+
+    bool VisitOverloadExpr(OverloadExpr *e) {
+      for (OverloadExpr::decls_iterator I = e->decls_begin(),
+          E = e->decls_end(); I != E; ++I) {
+        const NamedDecl *d = (*I)->getUnderlyingDecl();
+        if (const FunctionTemplateDecl *t = dyn_cast<FunctionTemplateDecl>(d))
+          d = t->getTemplatedDecl();
+        const CXXMethodDecl *m = dyn_cast<CXXMethodDecl>(d);
+        if (IsPrivate(m))
+          methods[m->getCanonicalDecl()].opaque = true;
+      }
+      return true;
+    }
+
+    bool VisitCallExpr(CallExpr *e) {
+      const CXXMethodDecl *m = dyn_cast_or_null<CXXMethodDecl>(
+          e->getDirectCallee());
+      if (!IsPrivate(m))
+        return true;
+      Usage &u = methods[m->getCanonicalDecl()];
+      ++u.calls;
+      if (discardedCalls.count(e))
+        ++u.discarded;
+      if (keepSites)
+        u.sites.push_back(e);
+      return true;
+    }
+
+    // statements whose value, if any, is dropped; these are visited before
+    // the calls inside them
+
+    bool VisitCompoundStmt(CompoundStmt *s) {
+      for (CompoundStmt::body_iterator I = s->body_begin(),
+          E = s->body_end(); I != E; ++I)
+        Discarded(*I);
+      return true;
+    }
+
+    bool VisitIfStmt(IfStmt *s) {
+      Discarded(s->getThen());
+      Discarded(s->getElse());
+      return true;
+    }
+
+    bool VisitForStmt(ForStmt *s) {
+      Discarded(s->getInit());
+      Discarded(s->getInc());
+      Discarded(s->getBody());
+      return true;
+    }
+
+    bool VisitWhileStmt(WhileStmt *s) {
+      Discarded(s->getBody());
+      return true;
+    }
+
+    bool VisitDoStmt(DoStmt *s) {
+      Discarded(s->getBody());
+      return true;
+    }
+
+    bool VisitSwitchCase(SwitchCase *s) {
+      Discarded(s->getSubStmt());
+      return true;
+    }
+
+    bool VisitLabelStmt(LabelStmt *s) {
+      Discarded(s->getSubStmt());
+      return true;
+    }
+
+    bool VisitExplicitCastExpr(ExplicitCastExpr *e) {
+      if (e->getCastKind() == CK_ToVoid)
+        Discarded(e->getSubExpr());
+      return true;
+    }
+
+    bool VisitBinaryOperator(BinaryOperator *e) {
+      if (e->getOpcode() == BO_Comma)
+        Discarded(e->getLHS());
+      return true;
+    }
+  private:
+    bool keepSites;
+    // method definitions being traversed, innermost last
+    std::vector<const CXXMethodDecl *> bodies;
+    llvm::DenseSet<const CallExpr *> discardedCalls;
+
+    static bool IsPrivate(const CXXMethodDecl *m) {
+      return m && m->getAccess() == AS_private;
+    }
+
+    void Named(const CXXMethodDecl *m) {
+      if (IsPrivate(m))
+        ++methods[m->getCanonicalDecl()].refs;
+    }
+
+    void Discarded(Stmt *s) {
+      Expr *e = dyn_cast_or_null<Expr>(s);
+      if (!e)
+        return;
+      e = IgnoreTemporaries(e);
+
+      if (CallExpr *call = dyn_cast<CallExpr>(e))
+        discardedCalls.insert(call);
+      else if (BinaryOperator *b = dyn_cast<BinaryOperator>(e)) {
+        if (b->getOpcode() == BO_Comma)
+          Discarded(b->getRHS());
+      } else if (ConditionalOperator *c = dyn_cast<ConditionalOperator>(e)) {
+        Discarded(c->getTrueExpr());
+        Discarded(c->getFalseExpr());
+      }
+    }
+};
+
+}
+
+Analysis::Analysis(ASTContext &c, const AnalysisOptions &opts)
+  : ctx(c), options(opts), candidates(0) {
+  std::sort(options.ignoredFiles.begin(), options.ignoredFiles.end());
+}
+
+Analysis::~Analysis() { }
+
+void Analysis::Snapshot() {
+  PerfScope snapshotScope(options.perfCounters);
+
+  // gather lists of:
+  //  - not fully defined classes
+  //  - all the private methods
+  DeclCollector collector(ctx, undefinedClasses, unusedPrivateMethods,
+      options.includeTemplateMethods);
+  collector.TraverseDecl(ctx.getTranslationUnitDecl());
+  candidates = unusedPrivateMethods.size();
+  snapshotScope.Stop(collectCounters);
+}
+
+void Analysis::Collect() {
+  TranslationUnitDecl *tuDecl = ctx.getTranslationUnitDecl();
+  PerfScope collectScope(options.perfCounters);
+
+  DeclRemover remover(unusedPrivateMethods);
+  remover.TraverseDecl(tuDecl);
+  collectScope.Stop(collectCounters);
+
+  // the arguments are evaluated and the layouts computed in Resolve(): both
+  // fill caches of the ASTContext and must not race with code generation
+  if (options.adviseSignatures || options.adviseConstantArgs ||
+      options.adviseCopies || options.adviseLayout) {
+    PerfScope usageScope(options.perfCounters);
+    usage.reset(new UsageScan(options.adviseConstantArgs ||
+          options.adviseCopies));
+    usage->TraverseDecl(tuDecl);
+    usageScope.Stop(usageCounters);
+  }
+}
+
+void Analysis::Resolve(AnalysisResult &result) const {
+  PerfScope resolveScope(options.perfCounters);
+  AnalysisStats &stats = result.statistics;
+  stats.candidates = candidates;
+  stats.unreferenced = unusedPrivateMethods.size();
+
+  for (MethodSet::const_iterator I = unusedPrivateMethods.begin(),
+      E = unusedPrivateMethods.end(); I != E; ++I) {
+    const CXXMethodDecl *m = *I;
+    Skip skip = { m, SR_Ignored };
+
+    if (IsIgnored(m))
+      skip.reason = SR_Ignored;
+    // care only about fully defined classes
+    else if (!IsDefined(m->getParent()))
+      skip.reason = SR_NotClosed;
+    // some people declare private never used ctors/dtors purposefully
+    else if (isa<CXXConstructorDecl>(m) || isa<CXXDestructorDecl>(m))
+      skip.reason = SR_Structor;
+    else {
+      Finding finding = { m };
+      result.found.push_back(finding);
+      continue;
+    }
+    result.skips.push_back(skip);
+  }
+  stats.findings = result.found.size();
+  stats.skipped = result.skips.size();
+
+  if (usage)
+    Advise(result);
+  if (usage && options.adviseLayout)
+    AdviseLayout(result);
+
+  if (options.perfCounters) {
+    result.phaseCounters.resize(AP_NumPhases);
+    result.phaseCounters[AP_Collect] = collectCounters;
+    result.phaseCounters[AP_Usage] = usageCounters;
+    resolveScope.Stop(result.phaseCounters[AP_Resolve]);
+  }
+}
+
+void Analysis::Advise(AnalysisResult &result) const {
+  for (UsageScan::UsageMap::const_iterator I = usage->methods.begin(),
+      E = usage->methods.end(); I != E; ++I) {
+    const CXXMethodDecl *m = I->first;
+    const UsageScan::Usage &u = I->second;
+    const FunctionDecl *body;
+
+    // unused ones are findings already; with the address taken, calls
+    // through pointers are not seen
+    if (!u.calls || u.opaque || u.refs != u.calls)
+      continue;
+    if (m->isVirtual() || m->isOverloadedOperator() ||
+        isa<CXXConstructorDecl>(m) || isa<CXXDestructorDecl>(m) ||
+        isa<CXXConversionDecl>(m) || m->getDescribedFunctionTemplate() ||
+        m->isDependentContext() || m->isFunctionTemplateSpecialization())
+      continue;
+    if (!m->isDefined(body) || IsIgnored(m) || !IsDefined(m->getParent()))
+      continue;
+    const CXXMethodDecl *def = cast<CXXMethodDecl>(body);
+
+    Advice advice = { def, AK_UnreadParameter, 0, u.calls, 0, 0 };
+    if (options.adviseSignatures) {
+      for (unsigned i = 0, e = def->getNumParams(); i != e; ++i) {
+        advice.param = def->getParamDecl(i);
+        if (!usage->referencedParams.count(advice.param))
+          result.advised.push_back(advice);
+      }
+      advice.param = 0;
+
+      if (!def->getResultType()->isVoidType() && u.discarded == u.calls) {
+        advice.kind = AK_DiscardedResult;
+        result.advised.push_back(advice);
+      }
+      if (!def->isStatic() && !usage->usingThis.count(def)) {
+        advice.kind = AK_NoThis;
+        result.advised.push_back(advice);
+      }
+    }
+
+    if (options.adviseCopies) {
+      advice.kind = AK_CopiedParameter;
+      advice.argument = 0;
+      for (unsigned i = 0, e = def->getNumParams(); i != e; ++i) {
+        advice.param = def->getParamDecl(i);
+        if (!IsExpensiveCopy(advice.param->getType()) ||
+            IsModified(def, advice.param))
+          continue;
+        advice.lvalueArgs = CountCopiedLValues(u.sites, i);
+        result.advised.push_back(advice);
+      }
+    }
+
+    if (options.adviseConstantArgs) {
+      advice.kind = AK_ConstantArgument;
+      advice.lvalueArgs = 0;
+      for (unsigned i = 0, e = def->getNumParams(); i != e; ++i) {
+        advice.param = def->getParamDecl(i);
+        advice.argument = SameConstant(u.sites, i);
+        if (advice.argument && advice.param->getType()->isScalarType())
+          result.advised.push_back(advice);
+      }
+    }
+  }
+}
+
+// a class passed by value whose copy costs more than a couple of registers
+bool Analysis::IsExpensiveCopy(QualType t) const {
+  const CXXRecordDecl *r = t->getAsCXXRecordDecl();
+  if (!r || !r->hasDefinition() || t->isDependentType())
+    return false;
+  r = r->getDefinition();
+  return !r->isTriviallyCopyable() ||
+    ctx.getTypeSize(t) > 2 * ctx.getTargetInfo().getPointerWidth(0);
+}
+
+// Whether the body may modify or move from the parameter: some reference to
+// it ends up anywhere but in a const context (bound to a const reference,
+// the object of a const method, a field read, the range of a for loop whose
+// variable is a const reference).
+bool Analysis::IsModified(const CXXMethodDecl *def,
+    const ParmVarDecl *param) const {
+  if (param->getType().isConstQualified())
+    return false;
+  Stmt *body = def->getBody();
+  ParamRefCollector collector(param);
+  collector.TraverseStmt(body);
+  if (collector.refs.empty())
+    return false;
+
+  ParentMap parents(body);
+  for (unsigned i = 0, e = collector.refs.size(); i != e; ++i) {
+    const Expr *ref = collector.refs[i];
+    for (;;) {
+      if (ref->getType().isConstQualified())
+        break;
+      const Stmt *parent =
+        parents.getParentIgnoreParens(const_cast<Expr *>(ref));
+      if (const ImplicitCastExpr *c = dyn_cast_or_null<ImplicitCastExpr>(
+            parent)) {
+        if (c->getCastKind() == CK_LValueToRValue)
+          break;
+        if (c->getCastKind() == CK_NoOp ||
+            c->getCastKind() == CK_DerivedToBase ||
+            c->getCastKind() == CK_UncheckedDerivedToBase) {
+          ref = c;
+          continue;
+        }
+        return true;
+      }
+      // the range is bound to a non-const reference and iterated with the
+      // non-const begin() and end(), but only the loop variable gets at the
+      // elements
+      if (const DeclStmt *d = dyn_cast_or_null<DeclStmt>(parent)) {
+        const CXXForRangeStmt *loop = dyn_cast_or_null<CXXForRangeStmt>(
+            parents.getParent(const_cast<DeclStmt *>(d)));
+        if (!loop || loop->getRangeStmt() != d)
+          return true;
+        const QualType t = loop->getLoopVariable()->getType();
+        if (!t->isLValueReferenceType() ||
+            !t->getPointeeType().isConstQualified())
+          return true;
+        break;
+      }
+      const MemberExpr *m = dyn_cast_or_null<MemberExpr>(parent);
+      if (!m || m->isArrow() || m->getBase()->IgnoreParens() != ref)
+        return true;
+      if (isa<FieldDecl>(m->getMemberDecl())) {
+        ref = m;
+        continue;
+      }
+      const CXXMethodDecl *method =
+        dyn_cast<CXXMethodDecl>(m->getMemberDecl());
+      if (!method || !(method->isConst() || method->isStatic()))
+        return true;
+      break;
+    }
+  }
+  return false;
+}
+
+// calls that copy an lvalue into parameter 'i'; the others move from an
+// rvalue or construct the parameter in place
+unsigned Analysis::CountCopiedLValues(
+    const std::vector<const CallExpr *> &calls, unsigned i) const {
+  unsigned lvalues = 0;
+  for (unsigned c = 0, e = calls.size(); c != e; ++c) {
+    if (i >= calls[c]->getNumArgs())
+      continue;
+    const Expr *arg =
+      IgnoreTemporaries(const_cast<Expr *>(calls[c]->getArg(i)));
+    const CXXConstructExpr *construct = dyn_cast<CXXConstructExpr>(arg);
+    // a temporary's copy is elided (even if the constructor taking it is the
+    // copy constructor, as without a move constructor); what is copied is
+    // told by the source, not by the constructor chosen
+    if (construct && !construct->isElidable() &&
+        construct->getNumArgs() == 1 &&
+        construct->getConstructor()->isCopyOrMoveConstructor() &&
+        construct->getArg(0)->isLValue())
+      ++lvalues;
+  }
+  return lvalues;
+}
+
+// the argument at the first call if every call passes the same constant
+// for parameter 'i', else 0
+const Expr *Analysis::SameConstant(const std::vector<const CallExpr *> &calls,
+    unsigned i) const {
+  const Expr *first = 0;
+  APValue value;
+  for (unsigned c = 0, e = calls.size(); c != e; ++c) {
+    if (i >= calls[c]->getNumArgs())
+      return 0;
+    const Expr *arg = calls[c]->getArg(i);
+    Expr::EvalResult r;
+    if (arg->isValueDependent() || !arg->EvaluateAsRValue(r, ctx) ||
+        r.HasSideEffects)
+      return 0;
+    if (!first) {
+      first = arg;
+      value = r.Val;
+    } else if (!SameValue(value, r.Val))
+      return 0;
+  }
+  return first;
+}
+
+void Analysis::AdviseLayout(AnalysisResult &result) const {
+  // the accesses by class and method
+  typedef std::vector<std::pair<const FieldDecl *, unsigned> > FieldCounts;
+  typedef llvm::DenseMap<const CXXMethodDecl *, FieldCounts> BodyUses;
+  llvm::DenseMap<const RecordDecl *, BodyUses> classes;
+  for (UsageScan::FieldUseMap::const_iterator I = usage->fieldUses.begin(),
+      E = usage->fieldUses.end(); I != E; ++I) {
+    const FieldDecl *f = I->first.first;
+    classes[f->getParent()][I->first.second].push_back(
+        std::make_pair(f, I->second));
+  }
+
+  for (llvm::DenseMap<const RecordDecl *, BodyUses>::const_iterator
+      I = classes.begin(), E = classes.end(); I != E; ++I) {
+    const CXXRecordDecl *r = dyn_cast<CXXRecordDecl>(I->first);
+    if (!r)
+      continue;
+    unsigned n = 0;
+    for (RecordDecl::field_iterator F = r->field_begin(),
+        FE = r->field_end(); F != FE; ++F)
+      ++n;
+
+    // the weight of each field, and of the methods accessing each pair
+    std::vector<uint64_t> weights(n), together(n * n);
+    for (BodyUses::const_iterator B = I->second.begin(),
+        BE = I->second.end(); B != BE; ++B) {
+      const uint64_t w = Weight(B->first);
+      const FieldCounts &uses = B->second;
+      for (unsigned i = 0, e = uses.size(); i != e; ++i) {
+        const unsigned a = uses[i].first->getFieldIndex();
+        weights[a] += w * uses[i].second;
+        for (unsigned j = i + 1; j != e; ++j) {
+          const unsigned b = uses[j].first->getFieldIndex();
+          together[a * n + b] += w;
+          together[b * n + a] += w;
+        }
+      }
+    }
+
+    LayoutAdvice advice;
+    if (ProposeLayout(r, weights, together, advice))
+      result.layoutAdvice.push_back(advice);
+  }
+}
+
+bool Analysis::ProposeLayout(const CXXRecordDecl *r,
+    const std::vector<uint64_t> &weights,
+    const std::vector<uint64_t> &together, LayoutAdvice &advice) const {
+  // the order of public fields or of those laid out by attributes is not
+  // ours to change
+  if (r->isUnion() || r->isDependentContext() || r->isInvalidDecl() ||
+      r->getNumVBases() || r->hasAttr<PackedAttr>() || !IsDefined(r))
+    return false;
+  std::vector<const FieldDecl *> fields;
+  for (RecordDecl::field_iterator I = r->field_begin(), E = r->field_end();
+      I != E; ++I) {
+    if (I->isBitField() || I->getAccess() != AS_private ||
+        I->getType()->isIncompleteArrayType())
+      return false;
+    fields.push_back(*I);
+  }
+  const unsigned n = fields.size();
+  uint64_t total = 0;
+  for (unsigned i = 0; i != n; ++i)
+    total += weights[i];
+  if (n < 2 || !total)
+    return false;
+
+  // the layout as is, which laying the fields out again must reproduce
+  const ASTRecordLayout &layout = ctx.getASTRecordLayout(r);
+  const uint64_t start =
+    ctx.toCharUnitsFromBits(layout.getFieldOffset(0)).getQuantity();
+  std::vector<uint64_t> offsets;
+  const uint64_t end = LayOut(ctx, fields, start, offsets);
+  for (unsigned i = 0; i != n; ++i)
+    if (offsets[i] != ctx.toCharUnitsFromBits(
+          layout.getFieldOffset(i)).getQuantity())
+      return false;
+  const uint64_t align = layout.getAlignment().getQuantity();
+  const uint64_t size = layout.getSize().getQuantity();
+  if (llvm::RoundUpToAlignment(end, align) > size)
+    return false;
+  // what follows the fields (empty bases, tail padding)
+  const uint64_t tail = size - llvm::RoundUpToAlignment(end, align);
+
+  // hot: the fewest heaviest fields taking 90% of the accesses
+  std::vector<unsigned> byWeight;
+  for (unsigned i = 0; i != n; ++i)
+    byWeight.push_back(i);
+  std::stable_sort(byWeight.begin(), byWeight.end(), Heavier(weights));
+  unsigned hot = 0;
+  for (uint64_t sum = 0; sum * 10 < total * 9; ++hot)
+    sum += weights[byWeight[hot]];
+
+  // the heaviest first, then each time the one accessed most often along
+  // with the last placed
+  std::vector<unsigned> order(1, byWeight[0]);
+  std::vector<char> placed(n);
+  placed[byWeight[0]] = true;
+  while (order.size() != hot) {
+    const unsigned last = order.back();
+    unsigned best = n;
+    for (unsigned i = 0; i != hot; ++i) {
+      const unsigned f = byWeight[i];
+      if (!placed[f] && (best == n ||
+            together[last * n + f] > together[last * n + best]))
+        best = f;
+    }
+    placed[best] = true;
+    order.push_back(best);
+  }
+
+  std::vector<const FieldDecl *> proposed;
+  for (unsigned i = 0; i != hot; ++i)
+    proposed.push_back(fields[order[i]]);
+  for (unsigned i = hot; i != n; ++i)
+    proposed.push_back(fields[byWeight[i]]);
+  std::stable_sort(proposed.begin() + hot, proposed.end(), MoreAligned(ctx));
+
+  advice.record = r;
+  advice.order = proposed;
+  advice.weights.clear();
+  for (unsigned i = 0; i != n; ++i)
+    advice.weights.push_back(weights[proposed[i]->getFieldIndex()]);
+  advice.hot = hot;
+  advice.size = size;
+  std::vector<const FieldDecl *> hotFields;
+  std::vector<uint64_t> hotOffsets;
+  for (unsigned i = 0; i != hot; ++i) {
+    hotFields.push_back(fields[byWeight[i]]);
+    hotOffsets.push_back(offsets[byWeight[i]]);
+  }
+  advice.lines = CacheLines(ctx, hotFields, hotOffsets, hot);
+
+  std::vector<uint64_t> newOffsets;
+  const uint64_t newEnd = LayOut(ctx, proposed, start, newOffsets);
+  advice.newSize = llvm::RoundUpToAlignment(newEnd, align) + tail;
+  advice.newLines = CacheLines(ctx, proposed, newOffsets, hot);
+
+  // the hot fields and a pointer to the cold ones
+  advice.splitSize = 0;
+  if (hot != n) {
+    hotFields.assign(proposed.begin(), proposed.begin() + hot);
+    const uint64_t pointer = ctx.getTargetInfo().getPointerWidth(0) / 8;
+    const uint64_t splitEnd = llvm::RoundUpToAlignment(
+        LayOut(ctx, hotFields, start, hotOffsets), pointer) + pointer;
+    const uint64_t splitSize = llvm::RoundUpToAlignment(splitEnd,
+        std::max(align, pointer)) + tail;
+    if (splitSize + CacheLineBytes <= advice.newSize)
+      advice.splitSize = splitSize;
+  }
+
+  return advice.newLines < advice.lines || advice.newSize < advice.size ||
+    advice.splitSize;
+}
+
+// what an access in the body weighs
+uint64_t Analysis::Weight(const CXXMethodDecl *body) const {
+  const std::map<std::string, uint64_t> &profile = options.methodWeights;
+  if (profile.empty())
+    return 1;
+  if (!body)
+    return 0;
+  std::map<std::string, uint64_t>::const_iterator it =
+    profile.find(body->getQualifiedNameAsString());
+  return it != profile.end() ? it->second : 0;
+}
+
+// if the class is defined and its friend functions/friend classes' methods
+// are all defined
+bool Analysis::IsDefined(const CXXRecordDecl *r) const {
+  const ClassSet &undefined = undefinedClasses;
+  if (Contains(ctx, undefined, ctx.getRecordType(r)))
+    return false;
+
+  // whether all friends are defined
+  for (CXXRecordDecl::friend_iterator I = r->friend_begin(),
+      E = r->friend_end(); I != E; ++I) {
+    // it may be a function...
+    const NamedDecl *fDecl = (*I)->getFriendDecl();
+    const FunctionDecl *fFun = dyn_cast_or_null<FunctionDecl>(fDecl);
+    if (fFun) {
+      if (!fFun->getCanonicalDecl()->isDefined())
+        return false;
+    }
+
+    // ...or a type
+    const TypeSourceInfo *fInfo = (*I)->getFriendType();
+    if (fInfo) {
+      if (Contains(ctx, undefined,  fInfo->getType()))
+        return false;
+    }
+  }
+  // nothing suspicious found
+  return true;
+}
+
+bool Analysis::IsIgnored(const CXXMethodDecl *m) const {
+  const std::vector<std::string> &ignored = options.ignoredFiles;
+  if (ignored.empty())
+    return false;
+  const SourceManager &srcManager = ctx.getSourceManager();
+  const SourceLocation loc = m->getLocation();
+  const std::string file = srcManager.getPresumedLoc(loc).getFilename();
+  std::vector<std::string>::const_iterator it = std::lower_bound(
+      ignored.begin(), ignored.end(), file);
+  return it != ignored.end() && *it == file;
+}
+
+void deadmethod::Analyze(ASTContext &ctx, const AnalysisOptions &opts,
+    AnalysisResult &result) {
+  Analysis analysis(ctx, opts);
+  analysis.Snapshot();
+  analysis.Collect();
+  analysis.Resolve(result);
+}
+
+void deadmethod::Analyze(ASTUnit &unit, const AnalysisOptions &opts,
+    AnalysisResult &result) {
+  Analyze(unit.getASTContext(), opts, result);
+}
+
+void deadmethod::CollectFacts(ASTContext &ctx, deadfacts::TUFacts &facts,
+    CostModel *costs, PerfSample *counters) {
+  PerfScope scope(counters != 0);
+  FactCollector collector(ctx, facts, costs);
+  collector.TraverseDecl(ctx.getTranslationUnitDecl());
+  DispatchScan dispatch;
+  dispatch.TraverseDecl(ctx.getTranslationUnitDecl());
+  collector.Finish(dispatch);
+  if (counters)
+    scope.Stop(*counters);
+}
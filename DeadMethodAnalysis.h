@@ -0,0 +1,259 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// In-process interface to the analysis, for tools that want the results as
+// data rather than as diagnostics. The DeadAction plugin is a thin wrapper
+// around it; link the DeadMethodAnalysis library (DeadMethodAnalysis.cpp and
+// PerfCounters.cpp) to embed it.
+//
+// Results refer to the declarations of the analysed AST and carry no
+// formatted text, so they are valid as long as the ASTContext is.
+//
+#ifndef DEAD_METHOD_ANALYSIS_H
+#define DEAD_METHOD_ANALYSIS_H
+
+#include "PerfCounters.h"
+#include "clang/AST/DeclCXX.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/OwningPtr.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTContext;
+class ASTUnit;
+}
+
+namespace deadfacts {
+struct TUFacts;
+}
+
+namespace deadmethod {
+
+struct AnalysisOptions {
+  // report (possibly) unused templated methods as well
+  bool includeTemplateMethods;
+  // methods declared in these files are skipped (exact paths as used by the
+  // compiler)
+  std::vector<std::string> ignoredFiles;
+  // look for private methods whose signature could be slimmer (see Advice)
+  bool adviseSignatures;
+  // look for parameters that get the same constant at every call
+  bool adviseConstantArgs;
+  // look for expensive parameters taken by value and never modified
+  bool adviseCopies;
+  // read hardware performance counters around each phase
+  bool perfCounters;
+  // propose field orders for closed classes (see LayoutAdvice)
+  bool adviseLayout;
+  // what the accesses in each method weigh for adviseLayout, by qualified
+  // name (e.g. sampled calls); methods missing weigh 0. If empty, every
+  // access weighs 1.
+  std::map<std::string, uint64_t> methodWeights;
+
+  AnalysisOptions()
+    : includeTemplateMethods(false), adviseSignatures(false),
+    adviseConstantArgs(false), adviseCopies(false), perfCounters(false),
+    adviseLayout(false) { }
+};
+
+// an unreferenced private method that was not reported, and why
+enum SkipReason {
+  // declared in one of the ignored files
+  SR_Ignored,
+  // the class or one of its friends is not fully defined here
+  SR_NotClosed,
+  // constructor or destructor, often declared private on purpose
+  SR_Structor
+};
+
+struct Finding {
+  const clang::CXXMethodDecl *method;
+};
+
+struct Skip {
+  const clang::CXXMethodDecl *method;
+  SkipReason reason;
+};
+
+// Advice on private methods of closed classes, whose every call is visible
+// in the translation unit. Methods whose signature is not theirs to change
+// (virtual, operators, structors, templates) or whose address is taken are
+// left alone.
+enum AdviceKind {
+  // the parameter is never referred to in the body
+  AK_UnreadParameter,
+  // every call discards the returned value
+  AK_DiscardedResult,
+  // the body does not use 'this', the method could be static
+  AK_NoThis,
+  // every call passes the same constant for the (scalar) parameter
+  AK_ConstantArgument,
+  // a class that is expensive to copy, taken by value and never modified
+  // or moved from in the body
+  AK_CopiedParameter
+};
+
+struct Advice {
+  // the definition
+  const clang::CXXMethodDecl *method;
+  AdviceKind kind;
+  // the parameter of the definition concerned, 0 if none
+  const clang::ParmVarDecl *param;
+  // calls of the method in the translation unit
+  unsigned calls;
+  // the argument at one of the calls (AK_ConstantArgument), else 0
+  const clang::Expr *argument;
+  // calls copying an lvalue into the parameter (AK_CopiedParameter); the
+  // rest pass rvalues
+  unsigned lvalueArgs;
+};
+
+// A field order for a closed class whose fields are all private: the hot
+// ones first, those accessed by the same methods next to each other, then
+// the cold ones by decreasing alignment. Hot are the fewest fields taking
+// 90% of the (weighted) accesses. Sizes are in bytes; cache lines count
+// those the hot fields touch with the object at the start of one.
+struct LayoutAdvice {
+  const clang::CXXRecordDecl *record;
+  // every field, in the proposed order; the first 'hot' are hot
+  std::vector<const clang::FieldDecl *> order;
+  // weighted accesses, parallel to 'order'
+  std::vector<uint64_t> weights;
+  unsigned hot;
+  uint64_t size;
+  uint64_t newSize;
+  // with the cold fields moved to an object of their own behind a
+  // pointer; 0 unless that saves a cache line
+  uint64_t splitSize;
+  unsigned lines;
+  unsigned newLines;
+};
+
+struct AnalysisStats {
+  // private methods considered
+  unsigned candidates;
+  // of those, the ones no expression refers to
+  unsigned unreferenced;
+  unsigned findings;
+  unsigned skipped;
+
+  AnalysisStats() : candidates(0), unreferenced(0), findings(0), skipped(0) { }
+};
+
+// phases of the analysis, for the performance counters; CollectFacts() is not
+// one of them, it measures itself on request
+enum AnalysisPhase {
+  // collection of private methods and undefined classes, removal of the
+  // referenced methods
+  AP_Collect,
+  // the usage scan behind the advice
+  AP_Usage,
+  // closure resolution and the advice
+  AP_Resolve,
+  AP_NumPhases
+};
+
+class AnalysisResult {
+  public:
+    // in no particular order
+    llvm::ArrayRef<Finding> findings() const { return found; }
+    llvm::ArrayRef<Skip> skipped() const { return skips; }
+    llvm::ArrayRef<Advice> advice() const { return advised; }
+    llvm::ArrayRef<LayoutAdvice> layouts() const { return layoutAdvice; }
+    const AnalysisStats &stats() const { return statistics; }
+    // by AnalysisPhase, empty unless asked for
+    llvm::ArrayRef<PerfSample> counters() const { return phaseCounters; }
+  private:
+    friend class Analysis;
+
+    std::vector<Finding> found;
+    std::vector<Skip> skips;
+    std::vector<Advice> advised;
+    std::vector<LayoutAdvice> layoutAdvice;
+    AnalysisStats statistics;
+    std::vector<PerfSample> phaseCounters;
+};
+
+// The analysis of one translation unit in three steps. Snapshot() records
+// the private methods and the classes not defined (by their canonical
+// declarations and types, asking the ASTContext) and belongs to the thread
+// that owns the compiler instance. Collect() then only reads the bodies:
+// expressions and the declarations they name, which Sema built and nobody
+// changes afterwards. It may run on another thread while code generation
+// fills the memo tables of the ASTContext (type info, record layouts,
+// mangling) and the lazily computed data of declarations (linkage,
+// conversion functions), none of which it consults. Resolve() consults the
+// SourceManager, evaluates and lays out, so it is back on the owning thread.
+// Walking an AST with an ExternalASTSource (PCH, modules) deserializes
+// declarations and bodies on first access, which writes the ASTContext;
+// such ASTs must be collected on the owning thread.
+class UsageScan;
+
+class Analysis {
+  public:
+    Analysis(clang::ASTContext &ctx, const AnalysisOptions &opts);
+    ~Analysis();
+
+    void Snapshot();
+    void Collect();
+    void Resolve(AnalysisResult &result) const;
+  private:
+    typedef llvm::DenseSet<const clang::CXXMethodDecl *> MethodSet;
+    typedef llvm::DenseSet<const clang::Type *> ClassSet;
+
+    clang::ASTContext &ctx;
+    AnalysisOptions options;
+    MethodSet unusedPrivateMethods;
+    ClassSet undefinedClasses;
+    unsigned candidates;
+    // how the private methods are called (only when advising)
+    llvm::OwningPtr<UsageScan> usage;
+    // of the phases Snapshot() and Collect() run
+    PerfSample collectCounters;
+    PerfSample usageCounters;
+
+    bool IsDefined(const clang::CXXRecordDecl *r) const;
+    bool IsIgnored(const clang::CXXMethodDecl *m) const;
+    void Advise(AnalysisResult &result) const;
+    const clang::Expr *SameConstant(
+        const std::vector<const clang::CallExpr *> &calls, unsigned i) const;
+    bool IsExpensiveCopy(clang::QualType t) const;
+    bool IsModified(const clang::CXXMethodDecl *def,
+        const clang::ParmVarDecl *param) const;
+    unsigned CountCopiedLValues(
+        const std::vector<const clang::CallExpr *> &calls, unsigned i) const;
+    void AdviseLayout(AnalysisResult &result) const;
+    bool ProposeLayout(const clang::CXXRecordDecl *r,
+        const std::vector<uint64_t> &weights,
+        const std::vector<uint64_t> &together, LayoutAdvice &advice) const;
+    uint64_t Weight(const clang::CXXMethodDecl *body) const;
+};
+
+// Estimates the compile-time cost of a method body in seconds; see
+// DeadMethodCost.h for the one based on code generation.
+class CostModel {
+  public:
+    virtual ~CostModel() { }
+    virtual double Cost(const clang::CXXMethodDecl *m) = 0;
+};
+
+// one-shot helpers
+void Analyze(clang::ASTContext &ctx, const AnalysisOptions &opts,
+    AnalysisResult &result);
+void Analyze(clang::ASTUnit &unit, const AnalysisOptions &opts,
+    AnalysisResult &result);
+
+// the facts the whole-program driver merges (see DeadFacts.h); with 'costs',
+// private methods this translation unit defines but does not refer to get
+// their cost recorded; with 'counters', the hardware counters of the whole
+// collection (measuring the costs included) are added to it
+void CollectFacts(clang::ASTContext &ctx, deadfacts::TUFacts &facts,
+    CostModel *costs = 0, PerfSample *counters = 0);
+
+}
+
+#endif
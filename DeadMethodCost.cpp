@@ -0,0 +1,61 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Re-emission of single method bodies into scratch modules.
+//
+#include "DeadMethodCost.h"
+#include "clang/AST/AST.h"
+#include "clang/CodeGen/ModuleBuilder.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/LLVMContext.h"
+#include "llvm/Support/Timer.h"
+
+using namespace clang;
+using namespace deadmethod;
+
+double CodeGenCost::Cost(const CXXMethodDecl *m) {
+  m = m->getCanonicalDecl();
+  llvm::DenseMap<const CXXMethodDecl *, double>::iterator it = costs.find(m);
+  if (it != costs.end())
+    return it->second;
+
+  double seconds = 0;
+  if (const FunctionTemplateDecl *t = m->getDescribedFunctionTemplate()) {
+    // the template itself generates nothing, its instantiations do
+    for (FunctionTemplateDecl::spec_iterator I = t->spec_begin(),
+        E = t->spec_end(); I != E; ++I)
+      seconds += Emit(*I);
+  } else
+    seconds = Emit(m);
+  costs[m] = seconds;
+  return seconds;
+}
+
+double CodeGenCost::Emit(const FunctionDecl *f) {
+  const FunctionDecl *def;
+  if (!f->isDefined(def) || def->isDependentContext() ||
+      isa<CXXConstructorDecl>(def) || isa<CXXDestructorDecl>(def))
+    return 0;
+  // an inline or internal body nothing uses is deferred and never emitted,
+  // so it costs the translation unit nothing beyond parsing
+  ASTContext &ctx = ci.getASTContext();
+  if (!ctx.DeclMustBeEmitted(def))
+    return 0;
+
+  // A module of its own, so that callees emitted for it (inline functions,
+  // instantiations) are charged to it and not shared with other methods.
+  llvm::LLVMContext context;
+  llvm::OwningPtr<CodeGenerator> gen(CreateLLVMCodeGen(ci.getDiagnostics(),
+        "dead-method-cost", ci.getCodeGenOpts(), ci.getTargetOpts(),
+        context));
+  gen->Initialize(ctx);
+
+  const llvm::TimeRecord start = llvm::TimeRecord::getCurrentTime(true);
+  gen->HandleTopLevelDecl(DeclGroupRef(const_cast<FunctionDecl *>(def)));
+  gen->HandleTranslationUnit(ctx);
+  const llvm::TimeRecord end = llvm::TimeRecord::getCurrentTime(false);
+
+  return end.getProcessTime() - start.getProcessTime();
+}
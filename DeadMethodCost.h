@@ -0,0 +1,42 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Compile-time cost of a method body: the CPU time it takes to generate IR for
+// the method alone in a scratch module, its instantiations included. This is
+// what the translation unit spends on the body on top of parsing it; Sema
+// time is not attributable after the fact and is left out. Only bodies the
+// translation unit really emits are charged: an unused inline body (defined
+// in the class, or declared inline) is never generated and costs 0, so the
+// costs of the translation units of a program add up.
+//
+#ifndef DEAD_METHOD_COST_H
+#define DEAD_METHOD_COST_H
+
+#include "DeadMethodAnalysis.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace clang {
+class CompilerInstance;
+}
+
+namespace deadmethod {
+
+// Measures with the code generation options of the compiler instance. Costs
+// are cached, so asking twice for a method is free. Use on the thread that
+// owns the compiler instance, after (or instead of) code generation.
+class CodeGenCost : public CostModel {
+  public:
+    CodeGenCost(clang::CompilerInstance &c) : ci(c) { }
+
+    virtual double Cost(const clang::CXXMethodDecl *m);
+  private:
+    clang::CompilerInstance &ci;
+    llvm::DenseMap<const clang::CXXMethodDecl *, double> costs;
+
+    double Emit(const clang::FunctionDecl *f);
+};
+
+}
+
+#endif
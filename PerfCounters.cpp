@@ -0,0 +1,97 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// perf_event_open wrappers.
+//
+#include "PerfCounters.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <cstring>
+#include <unistd.h>
+#endif
+
+using namespace deadmethod;
+
+const char *const deadmethod::PerfEventNames[PE_NumEvents] = {
+  "cycles", "instructions", "llc-misses", "branch-misses"
+};
+
+#ifdef __linux__
+
+namespace {
+
+int OpenCounter(PerfEvent event) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  switch (event) {
+    case PE_Cycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PE_Instructions:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PE_CacheMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_LL |
+        PERF_COUNT_HW_CACHE_OP_READ << 8 |
+        PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+      break;
+    default:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+  }
+  // this thread, any CPU
+  const int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  if (fd >= 0)
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  return fd;
+}
+
+}
+
+PerfScope::PerfScope(bool enabled) {
+  for (unsigned i = 0; i != PE_NumEvents; ++i)
+    fds[i] = enabled ? OpenCounter(PerfEvent(i)) : -1;
+}
+
+PerfScope::~PerfScope() {
+  for (unsigned i = 0; i != PE_NumEvents; ++i)
+    if (fds[i] >= 0)
+      close(fds[i]);
+}
+
+void PerfScope::Stop(PerfSample &sample) {
+  for (unsigned i = 0; i != PE_NumEvents; ++i) {
+    uint64_t count;
+    if (fds[i] < 0)
+      continue;
+    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fds[i], &count, sizeof(count)) == sizeof(count)) {
+      sample.counts[i] += count;
+      sample.valid[i] = true;
+    }
+  }
+}
+
+#else
+
+PerfScope::PerfScope(bool) {
+  for (unsigned i = 0; i != PE_NumEvents; ++i)
+    fds[i] = -1;
+}
+
+PerfScope::~PerfScope() { }
+
+void PerfScope::Stop(PerfSample &) { }
+
+#endif
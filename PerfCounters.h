@@ -0,0 +1,64 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Hardware performance counters (Linux perf_event_open) for the phases of the
+// analysis: cycles, instructions, last level cache misses and branch misses
+// of the calling thread. Counters the kernel or the machine does not offer
+// (non-Linux hosts, most virtual machines for the cache) are left invalid.
+//
+#ifndef DEAD_METHOD_PERF_COUNTERS_H
+#define DEAD_METHOD_PERF_COUNTERS_H
+
+#include "llvm/Support/DataTypes.h"
+
+namespace deadmethod {
+
+enum PerfEvent {
+  PE_Cycles,
+  PE_Instructions,
+  PE_CacheMisses,
+  PE_BranchMisses,
+  PE_NumEvents
+};
+
+// short names, as printed
+extern const char *const PerfEventNames[PE_NumEvents];
+
+struct PerfSample {
+  uint64_t counts[PE_NumEvents];
+  bool valid[PE_NumEvents];
+
+  PerfSample() {
+    for (unsigned i = 0; i != PE_NumEvents; ++i) {
+      counts[i] = 0;
+      valid[i] = false;
+    }
+  }
+
+  void Add(const PerfSample &s) {
+    for (unsigned i = 0; i != PE_NumEvents; ++i) {
+      counts[i] += s.counts[i];
+      valid[i] |= s.valid[i];
+    }
+  }
+};
+
+// counts the events of the calling thread from construction to Stop()
+class PerfScope {
+  public:
+    PerfScope(bool enabled);
+    ~PerfScope();
+
+    // adds to 'sample'; call once, on the thread that created the scope
+    void Stop(PerfSample &sample);
+  private:
+    int fds[PE_NumEvents];
+
+    PerfScope(const PerfScope &);
+    void operator=(const PerfScope &);
+};
+
+}
+
+#endif
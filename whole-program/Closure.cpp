@@ -0,0 +1,191 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Writing and following the closure index.
+//
+#include "Closure.h"
+#include "DeadFacts.h"
+#include "Program.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+
+using namespace deadwp;
+
+namespace {
+
+const uint32_t ClosureMagic = 0x4c434d44; // "DMCL"
+const uint32_t ClosureVersion = 1;
+
+}
+
+void ClosureIndex::Write(const Program &program, llvm::raw_ostream &out) {
+  deadfacts::WriteU32(out, ClosureMagic);
+  deadfacts::WriteU32(out, ClosureVersion);
+  deadfacts::WriteU32(out, program.NumTranslationUnits());
+  for (unsigned i = 0, e = program.NumTranslationUnits(); i != e; ++i)
+    deadfacts::WriteString(out, program.TranslationUnit(i));
+
+  // only classes with something to report and a chance to close
+  std::vector<unsigned> ids;
+  std::vector<std::vector<std::vector<unsigned> > > requirements;
+  for (unsigned id = 0, e = program.NumIds(); id != e; ++id) {
+    const ClassInfo &c = program.Class(id);
+    if (!c.defined || c.methods.empty())
+      continue;
+    std::vector<std::vector<unsigned> > r;
+    program.Requirements(id, r);
+    if (r.empty() || r.front().empty())
+      continue;
+    ids.push_back(id);
+    requirements.push_back(r);
+  }
+
+  deadfacts::WriteU32(out, ids.size());
+  for (unsigned i = 0, e = ids.size(); i != e; ++i) {
+    deadfacts::WriteString(out, program.Class(ids[i]).key);
+    const std::vector<std::vector<unsigned> > &r = requirements[i];
+    deadfacts::WriteU32(out, r.size());
+    for (unsigned j = 0, je = r.size(); j != je; ++j) {
+      deadfacts::WriteU32(out, r[j].size());
+      for (unsigned k = 0, ke = r[j].size(); k != ke; ++k)
+        deadfacts::WriteU32(out, r[j][k]);
+    }
+  }
+}
+
+bool ClosureIndex::Load(llvm::StringRef path, std::string &error) {
+  llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+  if (llvm::error_code ec = llvm::MemoryBuffer::getFile(path, buffer)) {
+    error = ec.message();
+    return false;
+  }
+  llvm::StringRef in = buffer->getBuffer();
+
+  uint32_t magic, version;
+  if (!deadfacts::ReadU32(in, magic) || magic != ClosureMagic ||
+      !deadfacts::ReadU32(in, version) || version != ClosureVersion) {
+    error = "not a closure index";
+    return false;
+  }
+  uint32_t numClasses;
+  bool ok = deadfacts::ReadStrings(in, tus) &&
+    deadfacts::ReadU32(in, numClasses);
+  for (unsigned c = 0; ok && c != numClasses; ++c) {
+    std::string key;
+    uint32_t numRequirements;
+    ok = deadfacts::ReadString(in, key) &&
+      deadfacts::ReadU32(in, numRequirements);
+    classKeys.push_back(key);
+    classIndex[key] = c;
+    firstRequirement.push_back(met.size());
+    remaining.push_back(numRequirements);
+    for (unsigned r = 0; ok && r != numRequirements; ++r) {
+      const Waiting w = { c, unsigned(met.size()) };
+      met.push_back(false);
+      requirementTUs.push_back(std::vector<unsigned>());
+      uint32_t numTUs, tu;
+      ok = deadfacts::ReadU32(in, numTUs);
+      for (unsigned t = 0; ok && t != numTUs; ++t) {
+        ok = deadfacts::ReadU32(in, tu) && tu < tus.size();
+        if (ok) {
+          waiting[tus[tu]].push_back(w);
+          requirementTUs.back().push_back(tu);
+        }
+      }
+    }
+  }
+  firstRequirement.push_back(met.size());
+  if (!ok)
+    error = "corrupted closure index";
+  return ok;
+}
+
+void ClosureIndex::Finished(llvm::StringRef tu,
+    std::vector<std::string> &ready) {
+  llvm::StringMap<std::vector<Waiting> >::iterator it = waiting.find(tu);
+  if (it == waiting.end())
+    return;
+  const std::vector<Waiting> &w = it->getValue();
+  for (unsigned i = 0, e = w.size(); i != e; ++i) {
+    if (met[w[i].requirement])
+      continue;
+    met[w[i].requirement] = true;
+    if (!--remaining[w[i].classIndex])
+      ready.push_back(classKeys[w[i].classIndex]);
+  }
+  waiting.erase(it);
+}
+
+void ClosureIndex::Plan(const std::vector<std::string> &classes,
+    std::vector<std::string> &plan, std::vector<std::string> &unknown) const {
+  // the open requirements, and for every translation unit the ones it meets
+  std::vector<unsigned> open;
+  for (unsigned i = 0, e = classes.size(); i != e; ++i) {
+    llvm::StringMap<unsigned>::const_iterator it =
+      classIndex.find(classes[i]);
+    if (it == classIndex.end()) {
+      unknown.push_back(classes[i]);
+      continue;
+    }
+    const unsigned c = it->getValue();
+    for (unsigned r = firstRequirement[c]; r != firstRequirement[c + 1]; ++r)
+      open.push_back(r);
+  }
+  std::sort(open.begin(), open.end());
+  open.erase(std::unique(open.begin(), open.end()), open.end());
+
+  std::vector<std::vector<unsigned> > meets(tus.size());
+  for (unsigned i = 0, e = open.size(); i != e; ++i) {
+    const std::vector<unsigned> &r = requirementTUs[open[i]];
+    for (unsigned t = 0, te = r.size(); t != te; ++t)
+      meets[r[t]].push_back(open[i]);
+  }
+
+  // greedy: the unit meeting most of what is still open
+  std::vector<char> isMet(requirementTUs.size(), true);
+  for (unsigned i = 0, e = open.size(); i != e; ++i)
+    isMet[open[i]] = false;
+  std::vector<unsigned> picked;
+  for (unsigned left = open.size(); left; ) {
+    unsigned best = 0, bestCount = 0;
+    for (unsigned t = 0, te = meets.size(); t != te; ++t) {
+      unsigned count = 0;
+      for (unsigned i = 0, e = meets[t].size(); i != e; ++i)
+        count += !isMet[meets[t][i]];
+      if (count > bestCount) {
+        best = t;
+        bestCount = count;
+      }
+    }
+    // unreachable unless the index is corrupted
+    if (!bestCount)
+      break;
+    picked.push_back(best);
+    for (unsigned i = 0, e = meets[best].size(); i != e; ++i)
+      isMet[meets[best][i]] = true;
+    left -= bestCount;
+  }
+
+  // drop the units whose every requirement another pick meets as well
+  std::vector<unsigned> coverage(requirementTUs.size());
+  for (unsigned p = 0, pe = picked.size(); p != pe; ++p)
+    for (unsigned i = 0, e = meets[picked[p]].size(); i != e; ++i)
+      ++coverage[meets[picked[p]][i]];
+  for (unsigned p = picked.size(); p--; ) {
+    const std::vector<unsigned> &m = meets[picked[p]];
+    bool redundant = true;
+    for (unsigned i = 0, e = m.size(); redundant && i != e; ++i)
+      redundant = coverage[m[i]] > 1;
+    if (!redundant) {
+      plan.push_back(tus[picked[p]]);
+      continue;
+    }
+    for (unsigned i = 0, e = m.size(); i != e; ++i)
+      --coverage[m[i]];
+  }
+  std::reverse(plan.begin(), plan.end());
+}
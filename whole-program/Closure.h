@@ -0,0 +1,82 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Closure index: what each class needed to close in the previous run, so
+// that the next run can judge it as soon as that is in, long before the last
+// translation unit is.
+//
+// For every class with private methods, the index lists requirements, one
+// per method, friend and method of a friend or nested class; a requirement is
+// the set of translation units that defined the entity (any one will do).
+// A class whose requirements are all met is checked against the facts merged
+// so far: if it is closed, its findings are final. Otherwise (the code
+// changed since) it waits for the end of the run like any other.
+//
+// The same index plans partial runs: the translation units needed to close a
+// few given classes are a hitting set of their requirements. The plan is
+// greedy (the unit meeting most of the open requirements first) and then
+// pruned of units made redundant by later picks; not always the smallest,
+// but close to it for the usual shape of one or two units per class.
+//
+// Encoding as in DeadFacts.h: magic, version, the translation units, then per
+// class its key and its requirements as lists of translation unit numbers.
+//
+#ifndef DEAD_METHOD_CLOSURE_H
+#define DEAD_METHOD_CLOSURE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace deadwp {
+
+class Program;
+
+class ClosureIndex {
+  public:
+    // record the requirements of the classes of a merged program
+    static void Write(const Program &program, llvm::raw_ostream &out);
+
+    bool Load(llvm::StringRef path, std::string &error);
+
+    // the translation unit finished; append the keys of the classes whose
+    // requirements are met now
+    void Finished(llvm::StringRef tu, std::vector<std::string> &ready);
+
+    // translation units that close the given classes; classes the index
+    // does not know go to 'unknown'
+    void Plan(const std::vector<std::string> &classes,
+        std::vector<std::string> &plan,
+        std::vector<std::string> &unknown) const;
+  private:
+    // a requirement of a class, met by any of several translation units
+    struct Waiting {
+      unsigned classIndex;
+      unsigned requirement;
+    };
+
+    std::vector<std::string> tus;
+    std::vector<std::string> classKeys;
+    llvm::StringMap<unsigned> classIndex;
+    // the requirements of class i are firstRequirement[i] up to
+    // firstRequirement[i + 1]
+    std::vector<unsigned> firstRequirement;
+    // per requirement, the translation units meeting it
+    std::vector<std::vector<unsigned> > requirementTUs;
+    // per class, the requirements not met yet
+    std::vector<unsigned> remaining;
+    // per requirement (numbered across classes)
+    std::vector<char> met;
+    // by translation unit
+    llvm::StringMap<std::vector<Waiting> > waiting;
+};
+
+}
+
+#endif
@@ -0,0 +1,296 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// The process pool behind 'dead-method-wp run'.
+//
+#include "Coordinator.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace deadwp;
+
+namespace {
+
+int64_t NowMs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+}
+
+Coordinator::Coordinator(const std::vector<std::string> &cmd, unsigned j,
+    unsigned t, deadfacts::FactSink &s)
+  : command(cmd), jobs(j ? j : 1), timeout(t), sink(s) {
+  // a dying worker must not kill us on the next write
+  signal(SIGPIPE, SIG_IGN);
+}
+
+Coordinator::~Coordinator() {
+  for (unsigned i = 0, e = workers.size(); i != e; ++i)
+    Stop(workers[i]);
+}
+
+bool Coordinator::Spawn(Worker &w) {
+  int toChild[2], fromChild[2];
+  if (pipe(toChild))
+    return false;
+  if (pipe(fromChild)) {
+    close(toChild[0]);
+    close(toChild[1]);
+    return false;
+  }
+
+  const pid_t pid = fork();
+  if (pid == 0) {
+    dup2(toChild[0], 0);
+    dup2(fromChild[1], 1);
+    close(toChild[0]);
+    close(toChild[1]);
+    close(fromChild[0]);
+    close(fromChild[1]);
+    std::vector<char *> argv;
+    for (unsigned i = 0, e = command.size(); i != e; ++i)
+      argv.push_back(const_cast<char *>(command[i].c_str()));
+    argv.push_back(0);
+    execv(argv[0], &argv[0]);
+    _exit(127);
+  }
+
+  close(toChild[0]);
+  close(fromChild[1]);
+  if (pid < 0) {
+    close(toChild[1]);
+    close(fromChild[0]);
+    return false;
+  }
+  // keep our ends out of the workers spawned later, or EOF never comes
+  fcntl(toChild[1], F_SETFD, FD_CLOEXEC);
+  fcntl(fromChild[0], F_SETFD, FD_CLOEXEC);
+
+  w.pid = pid;
+  w.in = toChild[1];
+  w.out = fromChild[0];
+  w.tu.clear();
+  w.ready = false;
+  w.received.clear();
+  return true;
+}
+
+void Coordinator::Stop(Worker &w) {
+  if (w.pid < 0)
+    return;
+  // closing stdin tells the worker to finish
+  close(w.in);
+  close(w.out);
+  int status;
+  while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  w = Worker();
+}
+
+bool Coordinator::Assign(Worker &w, const std::string &tu) {
+  const std::string line = tu + "\n";
+  w.tu = tu;
+  w.deadline = NowMs() + int64_t(timeout) * 1000;
+  for (size_t done = 0; done != line.size(); ) {
+    const ssize_t n = write(w.in, line.data() + done, line.size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+void Coordinator::OnCrash(Worker &w) {
+  const std::string tu = w.tu;
+  const bool wasIsolated = w.isolated;
+  // it may still be alive if it merely garbled its output
+  kill(w.pid, SIGKILL);
+  Stop(w);
+  if (tu.empty())
+    return;
+  if (wasIsolated) {
+    llvm::errs() << "dead-method-wp: " << tu << ": crashes the analysis\n";
+    crashed.push_back(tu);
+  } else
+    suspects.push_back(tu);
+}
+
+// hand out work to idle workers, starting new ones up to 'jobs'
+void Coordinator::Schedule() {
+  for (unsigned i = 0, e = workers.size(); i != e; ++i) {
+    Worker &w = workers[i];
+    if (w.pid >= 0 && !w.tu.empty())
+      continue;
+    if (w.pid >= 0 && w.isolated) {
+      // done with its single translation unit
+      Stop(w);
+    }
+
+    if (!suspects.empty()) {
+      // a fresh process, so that nothing left by earlier translation units
+      // is to blame
+      Stop(w);
+      if (!Spawn(w))
+        return;
+      w.isolated = true;
+      const std::string tu = suspects.front();
+      suspects.pop_front();
+      if (!Assign(w, tu) && w.ready)
+        OnCrash(w);
+      continue;
+    }
+
+    if (pending.empty())
+      continue;
+    if (w.pid < 0 && !Spawn(w))
+      return;
+    const std::string tu = pending.front();
+    pending.pop_front();
+    // a worker not ready yet may have failed to start, which its output
+    // tells (see Run)
+    if (!Assign(w, tu) && w.ready)
+      OnCrash(w);
+  }
+}
+
+bool Coordinator::Receive(Worker &w) {
+  for (;;) {
+    llvm::StringRef in(w.received);
+    uint32_t status;
+    if (!deadfacts::ReadU32(in, status))
+      return true;
+
+    if (status == WS_Ready) {
+      w.ready = true;
+      w.received.erase(0, w.received.size() - in.size());
+      continue;
+    }
+    if (status == WS_Facts) {
+      // wait for the whole record: magic, version, size, payload
+      llvm::StringRef header = in;
+      uint32_t magic, version, size;
+      if (!deadfacts::ReadU32(header, magic) ||
+          !deadfacts::ReadU32(header, version) ||
+          !deadfacts::ReadU32(header, size) || header.size() < size)
+        return true;
+
+      deadfacts::TUFacts facts;
+      std::string error;
+      if (!deadfacts::ReadFacts(in, facts, error)) {
+        llvm::errs() << "dead-method-wp: " << w.tu << ": " << error << "\n";
+        return false;
+      }
+      sink.Add(facts);
+    } else if (status == WS_Failed)
+      failed.push_back(w.tu);
+    else
+      return false;
+
+    w.received.erase(0, w.received.size() - in.size());
+    w.tu.clear();
+  }
+}
+
+bool Coordinator::Expire() {
+  if (!timeout)
+    return true;
+  const int64_t now = NowMs();
+  for (unsigned i = 0, e = workers.size(); i != e; ++i) {
+    Worker &w = workers[i];
+    if (w.pid < 0 || w.tu.empty() || w.deadline > now)
+      continue;
+    if (!w.ready) {
+      llvm::errs() << "dead-method-wp: a worker did not get ready in "
+        << timeout << " s\n";
+      return false;
+    }
+    llvm::errs() << "dead-method-wp: " << w.tu << ": no result after "
+      << timeout << " s, killing the worker\n";
+    OnCrash(w);
+  }
+  return true;
+}
+
+int Coordinator::PollTimeout() const {
+  if (!timeout)
+    return -1;
+  int64_t next = -1;
+  for (unsigned i = 0, e = workers.size(); i != e; ++i)
+    if (workers[i].pid >= 0 && !workers[i].tu.empty() &&
+        (next < 0 || workers[i].deadline < next))
+      next = workers[i].deadline;
+  if (next < 0)
+    return -1;
+  const int64_t wait = next - NowMs();
+  if (wait < 0)
+    return 0;
+  return wait > INT_MAX ? INT_MAX : int(wait);
+}
+
+bool Coordinator::Run(const std::vector<std::string> &translationUnits) {
+  pending.assign(translationUnits.begin(), translationUnits.end());
+  workers.resize(jobs);
+
+  for (;;) {
+    Schedule();
+
+    std::vector<pollfd> fds;
+    std::vector<unsigned> owners;
+    for (unsigned i = 0, e = workers.size(); i != e; ++i)
+      if (workers[i].pid >= 0 && !workers[i].tu.empty()) {
+        pollfd p = { workers[i].out, POLLIN, 0 };
+        fds.push_back(p);
+        owners.push_back(i);
+      }
+    if (fds.empty()) {
+      if (pending.empty() && suspects.empty())
+        return true;
+      // nothing runs and nothing could be started
+      llvm::errs() << "dead-method-wp: cannot start workers\n";
+      return false;
+    }
+
+    if (poll(&fds[0], fds.size(), PollTimeout()) < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    for (unsigned i = 0, e = fds.size(); i != e; ++i) {
+      if (!fds[i].revents)
+        continue;
+      Worker &w = workers[owners[i]];
+      char buffer[65536];
+      const ssize_t n = read(w.out, buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n > 0) {
+        w.received.append(buffer, n);
+        if (Receive(w))
+          continue;
+      }
+      // exec failed, or the worker could not set itself up; every other
+      // worker would do the same
+      if (!w.ready) {
+        llvm::errs() << "dead-method-wp: a worker failed to start ("
+          << command.front() << ")\n";
+        return false;
+      }
+      OnCrash(w);
+    }
+    if (!Expire())
+      return false;
+  }
+}
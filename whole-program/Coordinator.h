@@ -0,0 +1,101 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Runs the per translation unit analysis in a pool of local worker processes
+// (dead-method-wp worker), so that a Clang crash on one translation unit does
+// not take the whole run down and allocators are not shared between threads.
+//
+// Protocol: a worker announces itself with a 32-bit WS_Ready once it is set
+// up; the coordinator writes one source path per line to its stdin; for each
+// the worker answers on stdout with a 32-bit status followed, on success, by
+// the facts record (DeadFacts.h). A worker that dies (or runs out of time)
+// with a translation unit in flight is replaced; the translation unit is
+// rerun alone in a fresh worker and only reported as crashing if that dies
+// too. A worker that dies before it is ready is not a crash but a broken
+// setup (no executable, no compilation database), and stops the run.
+//
+#ifndef DEAD_METHOD_COORDINATOR_H
+#define DEAD_METHOD_COORDINATOR_H
+
+#include "DeadFacts.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace deadwp {
+
+enum WorkerStatus {
+  WS_Facts = 0,
+  // the translation unit did not compile
+  WS_Failed = 1,
+  // set up and waiting for translation units
+  WS_Ready = 2
+};
+
+// worker side: analyse the translation units named on stdin
+int RunWorker(const std::string &buildPath);
+
+class Coordinator {
+  public:
+    // 'command' starts a worker (the executable first); a worker spending
+    // more than 'timeout' seconds (0: no limit) on a translation unit is
+    // killed, as if it crashed
+    Coordinator(const std::vector<std::string> &command, unsigned jobs,
+        unsigned timeout, deadfacts::FactSink &sink);
+    ~Coordinator();
+
+    // returns false if workers could not be started or failed to set up
+    bool Run(const std::vector<std::string> &translationUnits);
+
+    const std::vector<std::string> &Failed() const { return failed; }
+    const std::vector<std::string> &Crashed() const { return crashed; }
+  private:
+    struct Worker {
+      int pid;
+      // its stdin and stdout
+      int in;
+      int out;
+      // the translation unit in flight, empty when idle
+      std::string tu;
+      // runs a single, previously crashing, translation unit
+      bool isolated;
+      // announced WS_Ready
+      bool ready;
+      // when the translation unit in flight times out, in milliseconds of
+      // the monotonic clock
+      int64_t deadline;
+      std::string received;
+
+      Worker()
+        : pid(-1), in(-1), out(-1), isolated(false), ready(false),
+        deadline(0) { }
+    };
+
+    std::vector<std::string> command;
+    unsigned jobs;
+    unsigned timeout;
+    deadfacts::FactSink &sink;
+    std::vector<Worker> workers;
+    std::deque<std::string> pending;
+    // crashed once, to be rerun alone
+    std::deque<std::string> suspects;
+    std::vector<std::string> failed;
+    std::vector<std::string> crashed;
+
+    bool Spawn(Worker &w);
+    void Stop(Worker &w);
+    bool Assign(Worker &w, const std::string &tu);
+    void Schedule();
+    void OnCrash(Worker &w);
+    // crash the workers whose time is up; false if one was not even ready
+    bool Expire();
+    // milliseconds poll() may wait for the next deadline, -1 for ever
+    int PollTimeout() const;
+    // consume complete replies; false on a corrupted stream
+    bool Receive(Worker &w);
+};
+
+}
+
+#endif
@@ -0,0 +1,794 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// dead-method-wp: whole-program driver. Reads the facts the plugin embedded
+// (embed-facts) from the objects and archives that make up a binary, or
+// produces them in a pool of worker processes, and reports private methods
+// that are unused in the whole program.
+//
+#include "Program.h"
+#include "Closure.h"
+#include "Coordinator.h"
+#include "KeyIndex.h"
+#include "DeadFacts.h"
+#include "PerfCounters.h"
+#include "Virtuality.h"
+#include "Visibility.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Object/Archive.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+#include <map>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace deadwp;
+
+static cl::opt<std::string>
+Mode(cl::Positional, cl::Required, cl::desc("<mode>"),
+    cl::value_desc("report|run|plan|check|visibility|virtuality|"
+      "perf-totals|index|bench-index"));
+
+static cl::list<std::string>
+Inputs(cl::Positional, cl::ZeroOrMore,
+    cl::desc("<objects, archives or raw fact files | sources (run) | "
+      "classes (plan, check)>"));
+
+static cl::opt<bool>
+IncludeTemplateMethods("include-template-methods",
+    cl::desc("Look for template methods as well"));
+
+static cl::list<std::string>
+Ignored("ignore", cl::desc("Do not warn about methods declared in <file>"),
+    cl::value_desc("file"));
+
+static cl::opt<bool>
+ByCost("by-cost", cl::desc("Rank the unused methods by the compile time they "
+      "cost (needs facts from profile-cost)"));
+
+static cl::opt<std::string>
+IndexFile("index", cl::desc("Key index to map keys to IDs with"),
+    cl::value_desc("file"));
+
+static cl::opt<std::string>
+OutputFile("o", cl::desc("Output file (index mode)"),
+    cl::value_desc("file"));
+
+static cl::opt<std::string>
+BuildPath("p", cl::desc("Build directory with compile_commands.json (run)"),
+    cl::value_desc("dir"));
+
+static cl::opt<std::string>
+ClosureFile("closure", cl::desc("Closure index: report classes as soon as "
+      "they close, as learnt from the previous run, and update it (run)"),
+    cl::value_desc("file"));
+
+static cl::opt<unsigned>
+Jobs("j", cl::desc("Number of worker processes (run)"), cl::init(0));
+
+static cl::opt<unsigned>
+Timeout("timeout", cl::desc("Seconds a worker may spend on one translation "
+      "unit before it is killed and the unit treated as crashing, 0 for no "
+      "limit (run, check)"), cl::init(600), cl::value_desc("seconds"));
+
+static cl::opt<unsigned>
+BenchRounds("rounds", cl::desc("Lookups per key (bench-index mode)"),
+    cl::init(20));
+
+// to start workers with
+static const char *Argv0;
+
+namespace {
+
+using deadfacts::FactSink;
+
+class ProgramSink : public FactSink {
+  public:
+    ProgramSink(Program &p) : program(p) { }
+    virtual void Add(const deadfacts::TUFacts &facts) {
+      program.AddFacts(facts);
+    }
+  private:
+    Program &program;
+};
+
+// every key mentioned by the facts
+class KeySink : public FactSink {
+  public:
+    KeySink(std::vector<std::string> &k) : keys(k) { }
+    virtual void Add(const deadfacts::TUFacts &facts) {
+      for (unsigned i = 0, e = facts.classes.size(); i != e; ++i) {
+        const deadfacts::ClassFact &c = facts.classes[i];
+        keys.push_back(c.key);
+        if (!c.outer.empty())
+          keys.push_back(c.outer);
+        keys.insert(keys.end(), c.friendFunctions.begin(),
+            c.friendFunctions.end());
+        keys.insert(keys.end(), c.friendClasses.begin(),
+            c.friendClasses.end());
+      }
+      for (unsigned i = 0, e = facts.methods.size(); i != e; ++i)
+        keys.push_back(facts.methods[i].key);
+      for (unsigned i = 0, e = facts.refs.size(); i != e; ++i)
+        keys.push_back(facts.refs[i].key);
+    }
+  private:
+    std::vector<std::string> &keys;
+};
+
+bool Fail(StringRef path, StringRef msg) {
+  errs() << "dead-method-wp: " << path << ": " << msg << "\n";
+  return false;
+}
+
+// load every record found in a blob of facts
+bool LoadFacts(StringRef path, StringRef data, FactSink &sink) {
+  while (!data.empty()) {
+    deadfacts::TUFacts facts;
+    std::string error;
+    if (!deadfacts::ReadFacts(data, facts, error))
+      return Fail(path, error);
+    sink.Add(facts);
+  }
+  return true;
+}
+
+bool LoadObject(StringRef path, const object::ObjectFile *obj,
+    FactSink &sink) {
+  error_code ec;
+  for (object::section_iterator I = obj->begin_sections(),
+      E = obj->end_sections(); I != E; I.increment(ec)) {
+    if (ec)
+      return Fail(path, ec.message());
+    StringRef name, contents;
+    if ((ec = I->getName(name)))
+      return Fail(path, ec.message());
+    if (name != deadfacts::SectionName)
+      continue;
+    if ((ec = I->getContents(contents)))
+      return Fail(path, ec.message());
+    if (!LoadFacts(path, contents, sink))
+      return false;
+  }
+  return true;
+}
+
+bool LoadInput(StringRef path, FactSink &sink) {
+  OwningPtr<MemoryBuffer> buffer;
+  if (error_code ec = MemoryBuffer::getFileOrSTDIN(path, buffer))
+    return Fail(path, ec.message());
+
+  // facts extracted with objcopy -O binary -j .deadmethod
+  if (deadfacts::HasMagic(buffer->getBuffer()))
+    return LoadFacts(path, buffer->getBuffer(), sink);
+
+  OwningPtr<object::Binary> binary;
+  if (error_code ec = object::createBinary(buffer.take(), binary))
+    return Fail(path, ec.message());
+
+  if (const object::ObjectFile *obj =
+      dyn_cast<object::ObjectFile>(binary.get()))
+    return LoadObject(path, obj, sink);
+
+  const object::Archive *archive = dyn_cast<object::Archive>(binary.get());
+  if (!archive)
+    return Fail(path, "not an object file or archive");
+
+  for (object::Archive::child_iterator I = archive->begin_children(),
+      E = archive->end_children(); I != E; ++I) {
+    OwningPtr<object::Binary> member;
+    if (I->getAsBinary(member))
+      continue;
+    const object::ObjectFile *obj =
+      dyn_cast<object::ObjectFile>(member.get());
+    if (obj && !LoadObject(path, obj, sink))
+      return false;
+  }
+  return true;
+}
+
+bool LoadInputs(FactSink &sink) {
+  bool ok = true;
+  for (unsigned i = 0, e = Inputs.size(); i != e; ++i)
+    ok &= LoadInput(Inputs[i], sink);
+  return ok;
+}
+
+bool LoadIndex(KeyIndex &index) {
+  std::string error;
+  if (!IndexFile.empty() && !index.Load(IndexFile, error))
+    return Fail(IndexFile, error);
+  return true;
+}
+
+bool MoreCostly(const MethodInfo *a, const MethodInfo *b) {
+  return a->cost > b->cost;
+}
+
+void PrintFinding(const MethodInfo &m) {
+  outs() << m.file << ":" << m.line << ": warning: private method "
+    << m.name << " seems to be unused";
+  if (m.cost)
+    outs() << format(" (%.3f s of code generation in %u translation units)",
+        m.cost / 1e6, m.costTUs);
+  outs() << "\n";
+}
+
+// all the findings but those of the classes in 'reported' (by ID)
+void PrintUnused(const Program &program,
+    const std::vector<char> &reported = std::vector<char>()) {
+  std::vector<const MethodInfo *> unused;
+  program.FindUnused(unused);
+  if (ByCost)
+    std::stable_sort(unused.begin(), unused.end(), MoreCostly);
+
+  uint64_t total = 0;
+  for (unsigned i = 0, e = unused.size(); i != e; ++i) {
+    const unsigned classId = unused[i]->classId;
+    if (classId < reported.size() && reported[classId])
+      continue;
+    PrintFinding(*unused[i]);
+    total += unused[i]->cost;
+  }
+  if (total)
+    errs() << format("dead-method-wp: the unused methods cost %.3f s of "
+        "code generation in total\n", total / 1e6);
+}
+
+// Merges like ProgramSink and reports the classes the closure index says
+// are complete as soon as their last requirement is in.
+class OnlineSink : public FactSink {
+  public:
+    OnlineSink(Program &p, ClosureIndex &c)
+      : program(p), closure(c), classes(0) { }
+
+    virtual void Add(const deadfacts::TUFacts &facts) {
+      program.AddFacts(facts);
+      std::vector<std::string> ready;
+      closure.Finished(facts.tu, ready);
+      for (unsigned i = 0, e = ready.size(); i != e; ++i) {
+        const unsigned id = program.Id(ready[i]);
+        std::vector<const MethodInfo *> unused;
+        if (!program.FindUnusedIn(id, unused))
+          continue;
+        if (reported.size() <= id)
+          reported.resize(id + 1);
+        reported[id] = true;
+        ++classes;
+        for (unsigned j = 0, je = unused.size(); j != je; ++j)
+          PrintFinding(*unused[j]);
+      }
+      outs().flush();
+    }
+
+    // by class ID
+    const std::vector<char> &Reported() const { return reported; }
+    unsigned NumReported() const { return classes; }
+  private:
+    Program &program;
+    ClosureIndex &closure;
+    std::vector<char> reported;
+    unsigned classes;
+};
+
+int Report() {
+  KeyIndex index;
+  if (!LoadIndex(index))
+    return 1;
+  Program program(IncludeTemplateMethods, Ignored,
+      IndexFile.empty() ? 0 : &index);
+  ProgramSink sink(program);
+  bool ok = LoadInputs(sink);
+
+  PrintUnused(program);
+  if (!program.NumTranslationUnits())
+    errs() << "dead-method-wp: no facts found (compile with embed-facts)\n";
+  return ok ? 0 : 1;
+}
+
+// Files the facts of one library (or executable) into the advisor.
+class LibrarySink : public FactSink {
+  public:
+    LibrarySink(VisibilityAdvisor &a, unsigned l) : advisor(a), library(l) { }
+
+    virtual void Add(const deadfacts::TUFacts &facts) {
+      advisor.AddFacts(library, facts);
+    }
+  private:
+    VisibilityAdvisor &advisor;
+    unsigned library;
+};
+
+int AdviseVisibility() {
+  KeyIndex index;
+  if (!LoadIndex(index))
+    return 1;
+  Program program(IncludeTemplateMethods, Ignored,
+      IndexFile.empty() ? 0 : &index);
+  VisibilityAdvisor advisor(program);
+  bool ok = true;
+  for (unsigned i = 0, e = Inputs.size(); i != e; ++i) {
+    LibrarySink sink(advisor, advisor.AddLibrary(Inputs[i]));
+    ok &= LoadInput(Inputs[i], sink);
+  }
+
+  const std::vector<std::string> &libraries = advisor.Libraries();
+  VisibilityAdvisor::Savings total;
+  std::vector<char> covered(program.NumIds());
+  unsigned hidden = 0;
+
+  for (unsigned id = 0, e = program.NumIds(); id != e; ++id) {
+    VisibilityAdvisor::Savings s;
+    if (!advisor.CanHideClass(id, s))
+      continue;
+    const ClassInfo &c = program.Class(id);
+    const MethodInfo &first = program.Method(c.methods.front());
+    outs() << first.file << ":" << first.line << ": note: class " << c.name
+      << " is used only inside " << libraries[advisor.DefinedIn(id).front()]
+      << "; mark it __attribute__((visibility(\"hidden\"))) to drop "
+      << s.symbols << " dynamic symbols and " << s.relocations
+      << " relocations\n";
+    for (unsigned j = 0, je = c.methods.size(); j != je; ++j)
+      covered[c.methods[j]] = true;
+    total.symbols += s.symbols;
+    total.relocations += s.relocations;
+    ++hidden;
+  }
+
+  for (unsigned id = 0, e = program.NumIds(); id != e; ++id) {
+    VisibilityAdvisor::Savings s;
+    if (covered[id] || !advisor.CanHideMethod(id, s))
+      continue;
+    const MethodInfo &m = program.Method(id);
+    outs() << m.file << ":" << m.line << ": note: method " << m.name
+      << " is called only from the libraries defining it; hiding it drops "
+      << s.symbols << " dynamic symbols and " << s.relocations
+      << " relocations\n";
+    total.symbols += s.symbols;
+    total.relocations += s.relocations;
+    ++hidden;
+  }
+
+  errs() << "dead-method-wp: " << hidden << " classes and methods could be "
+    "hidden in " << libraries.size() << " libraries, saving "
+    << total.symbols << " dynamic symbols and " << total.relocations
+    << " relocations\n";
+  return ok ? 0 : 1;
+}
+
+class VirtualitySink : public FactSink {
+  public:
+    VirtualitySink(VirtualityAdvisor &a) : advisor(a) { }
+    virtual void Add(const deadfacts::TUFacts &facts) {
+      advisor.AddFacts(facts);
+    }
+  private:
+    VirtualityAdvisor &advisor;
+};
+
+int AdviseVirtuality() {
+  KeyIndex index;
+  if (!LoadIndex(index))
+    return 1;
+  Program program(IncludeTemplateMethods, Ignored,
+      IndexFile.empty() ? 0 : &index);
+  VirtualityAdvisor advisor(program);
+  VirtualitySink sink(advisor);
+  bool ok = LoadInputs(sink);
+
+  std::vector<VirtualityAdvisor::Hierarchy> hierarchies;
+  advisor.Find(hierarchies);
+  uint64_t vtableBytes = 0;
+  unsigned reported = 0;
+  for (unsigned i = 0, e = hierarchies.size(); i != e; ++i) {
+    const VirtualityAdvisor::Hierarchy &h = hierarchies[i];
+    // named after a class without bases, if there is one
+    unsigned root = h.classes.front();
+    for (unsigned j = 0, je = h.classes.size(); j != je; ++j)
+      if (advisor.Info(h.classes[j]).bases.empty()) {
+        root = h.classes[j];
+        break;
+      }
+    const VirtualityAdvisor::VTableInfo &r = advisor.Info(root);
+    outs() << r.file << ":" << r.line << ": note: no call "
+      "dispatches through the vtables of " << program.Class(root).name
+      << " and the " << h.classes.size() - 1 << " classes related to it ("
+      << h.calls << " direct calls); without virtual methods they would "
+      "drop about " << h.vtableBytes << " bytes of vtables\n";
+    // the fields move up, so padding may make the saving larger or smaller
+    for (unsigned j = 0, je = h.classes.size(); j != je; ++j) {
+      const VirtualityAdvisor::VTableInfo &c = advisor.Info(h.classes[j]);
+      outs() << c.file << ":" << c.line << ": note: objects of "
+        << program.Class(h.classes[j]).name << " (" << c.size
+        << " bytes) would shrink by about " << c.vptrBytes
+        << " bytes of vtable pointers, give or take padding\n";
+    }
+    vtableBytes += h.vtableBytes;
+    ++reported;
+  }
+
+  errs() << "dead-method-wp: " << reported << " class hierarchies "
+    "never dispatch virtually, carrying " << vtableBytes
+    << " bytes of vtables\n";
+  return ok ? 0 : 1;
+}
+
+// how the coordinator starts a worker
+void WorkerCommand(std::vector<std::string> &command) {
+  command.push_back(sys::Path::GetMainExecutable(Argv0,
+        (void *)(intptr_t)&WorkerCommand).str());
+  command.push_back("worker");
+  command.push_back("-p");
+  command.push_back(BuildPath);
+}
+
+unsigned NumJobs() {
+  if (Jobs)
+    return Jobs;
+  const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? cpus : 1;
+}
+
+// analyse the sources in a pool of worker processes and merge their facts
+int Run() {
+  if (BuildPath.empty()) {
+    errs() << "dead-method-wp: run mode needs -p <build directory>\n";
+    return 1;
+  }
+  std::vector<std::string> sources(Inputs.begin(), Inputs.end());
+  if (sources.empty()) {
+    std::string error;
+    OwningPtr<tooling::CompilationDatabase> db(
+        tooling::CompilationDatabase::loadFromDirectory(BuildPath, error));
+    if (!db) {
+      Fail(BuildPath, error);
+      return 1;
+    }
+    sources = db->getAllFiles();
+  }
+
+  KeyIndex index;
+  if (!LoadIndex(index))
+    return 1;
+  Program program(IncludeTemplateMethods, Ignored,
+      IndexFile.empty() ? 0 : &index);
+  // the closure index of the previous run, if any
+  ClosureIndex closure;
+  std::string error;
+  if (!ClosureFile.empty() && sys::fs::exists(ClosureFile) &&
+      !closure.Load(ClosureFile, error)) {
+    Fail(ClosureFile, error);
+    return 1;
+  }
+  OnlineSink sink(program, closure);
+
+  std::vector<std::string> command;
+  WorkerCommand(command);
+  Coordinator coordinator(command, NumJobs(), Timeout, sink);
+  if (!coordinator.Run(sources))
+    return 1;
+
+  PrintUnused(program, sink.Reported());
+  errs() << "dead-method-wp: " << program.NumTranslationUnits() << " of "
+    << sources.size() << " translation units analysed, "
+    << coordinator.Failed().size() << " failed to compile, "
+    << coordinator.Crashed().size() << " crashed, "
+    << sink.NumReported() << " classes reported early\n";
+
+  // for the next run
+  if (!ClosureFile.empty()) {
+    tool_output_file out(ClosureFile.c_str(), error, raw_fd_ostream::F_Binary);
+    if (!error.empty()) {
+      Fail(ClosureFile, error);
+      return 1;
+    }
+    ClosureIndex::Write(program, out.os());
+    out.keep();
+  }
+  return coordinator.Failed().empty() && coordinator.Crashed().empty() ? 0 : 1;
+}
+
+// the translation units to analyse to close the classes named by the
+// inputs; false if some class is not in the closure index
+bool MakePlan(std::vector<std::string> &plan) {
+  if (ClosureFile.empty()) {
+    errs() << "dead-method-wp: " << Mode << " mode needs -closure <file> "
+      "from a previous run\n";
+    return false;
+  }
+  ClosureIndex closure;
+  std::string error;
+  if (!closure.Load(ClosureFile, error))
+    return Fail(ClosureFile, error);
+
+  std::vector<std::string> classes(Inputs.begin(), Inputs.end());
+  std::vector<std::string> unknown;
+  closure.Plan(classes, plan, unknown);
+  for (unsigned i = 0, e = unknown.size(); i != e; ++i)
+    Fail(unknown[i], "class not in the closure index (check the qualified "
+        "name, or refresh the index with run -closure)");
+  return unknown.empty();
+}
+
+int PrintPlan() {
+  std::vector<std::string> plan;
+  if (!MakePlan(plan))
+    return 1;
+  for (unsigned i = 0, e = plan.size(); i != e; ++i)
+    outs() << plan[i] << "\n";
+  return 0;
+}
+
+// analyse only what the plan says, in parallel, and report on the classes
+// asked about
+int Check() {
+  if (BuildPath.empty()) {
+    errs() << "dead-method-wp: check mode needs -p <build directory>\n";
+    return 1;
+  }
+  std::vector<std::string> plan;
+  if (!MakePlan(plan))
+    return 1;
+
+  KeyIndex index;
+  if (!LoadIndex(index))
+    return 1;
+  Program program(IncludeTemplateMethods, Ignored,
+      IndexFile.empty() ? 0 : &index);
+  ProgramSink sink(program);
+  std::vector<std::string> command;
+  WorkerCommand(command);
+  Coordinator coordinator(command, NumJobs(), Timeout, sink);
+  if (!coordinator.Run(plan))
+    return 1;
+
+  bool closed = true;
+  for (unsigned i = 0, e = Inputs.size(); i != e; ++i) {
+    std::vector<const MethodInfo *> unused;
+    if (!program.FindUnusedIn(program.Id(Inputs[i]), unused)) {
+      // changed since the index was written
+      closed = Fail(Inputs[i], "not closed by the planned translation units; "
+          "rerun 'run -closure' to refresh the index");
+      continue;
+    }
+    for (unsigned j = 0, je = unused.size(); j != je; ++j)
+      PrintFinding(*unused[j]);
+  }
+  errs() << "dead-method-wp: " << program.NumTranslationUnits() << " of "
+    << plan.size() << " planned translation units analysed\n";
+  return closed && coordinator.Failed().empty() &&
+    coordinator.Crashed().empty() ? 0 : 1;
+}
+
+// Sum the counters the plugin printed with perf-counters over the given logs
+// (default: stdin), per phase.
+int PerfTotals() {
+  static const char Prefix[] = "dead-method perf: ";
+  std::vector<std::string> phases;
+  std::vector<std::vector<uint64_t> > sums;
+  unsigned tus = 0;
+
+  std::vector<std::string> logs(Inputs.begin(), Inputs.end());
+  if (logs.empty())
+    logs.push_back("-");
+  for (unsigned l = 0, le = logs.size(); l != le; ++l) {
+    OwningPtr<MemoryBuffer> buffer;
+    if (error_code ec = MemoryBuffer::getFileOrSTDIN(logs[l], buffer)) {
+      Fail(logs[l], ec.message());
+      return 1;
+    }
+    StringRef rest = buffer->getBuffer();
+    while (!rest.empty()) {
+      std::pair<StringRef, StringRef> split = rest.split('\n');
+      StringRef line = split.first;
+      rest = split.second;
+      const size_t at = line.find(Prefix);
+      if (at == StringRef::npos)
+        continue;
+      line = line.substr(at + sizeof(Prefix) - 1);
+
+      // <phase> <event>=<count>... <main file>
+      std::pair<StringRef, StringRef> field = line.split(' ');
+      const StringRef phase = field.first;
+      if (phase == "total") {
+        ++tus;
+        continue;
+      }
+      unsigned p = std::find(phases.begin(), phases.end(), phase) -
+        phases.begin();
+      if (p == phases.size()) {
+        phases.push_back(phase);
+        sums.push_back(std::vector<uint64_t>(deadmethod::PE_NumEvents));
+      }
+      for (unsigned i = 0; i != deadmethod::PE_NumEvents; ++i) {
+        field = field.second.ltrim().split(' ');
+        const std::pair<StringRef, StringRef> kv = field.first.split('=');
+        uint64_t count;
+        if (kv.first == deadmethod::PerfEventNames[i] &&
+            !kv.second.getAsInteger(10, count))
+          sums[p][i] += count;
+      }
+    }
+  }
+
+  outs() << format("%-10s", "phase");
+  for (unsigned i = 0; i != deadmethod::PE_NumEvents; ++i)
+    outs() << format(" %16s", deadmethod::PerfEventNames[i]);
+  outs() << format(" %6s %10s %10s\n", "IPC", "LLC MPKI", "br MPKI");
+  std::vector<uint64_t> total(deadmethod::PE_NumEvents);
+  for (unsigned p = 0, pe = phases.size() + 1; p != pe; ++p) {
+    const bool isTotal = p == phases.size();
+    const std::vector<uint64_t> &v = isTotal ? total : sums[p];
+    outs() << format("%-10s", isTotal ? "total" : phases[p].c_str());
+    for (unsigned i = 0; i != deadmethod::PE_NumEvents; ++i) {
+      outs() << format(" %16llu", (unsigned long long)v[i]);
+      if (!isTotal)
+        total[i] += v[i];
+    }
+    const double cycles = v[deadmethod::PE_Cycles];
+    const double kiloInstructions = v[deadmethod::PE_Instructions] / 1e3;
+    outs() << format(" %6.2f %10.2f %10.2f\n",
+        cycles ? v[deadmethod::PE_Instructions] / cycles : 0.0,
+        kiloInstructions ? v[deadmethod::PE_CacheMisses] / kiloInstructions
+        : 0.0,
+        kiloInstructions ? v[deadmethod::PE_BranchMisses] / kiloInstructions
+        : 0.0);
+  }
+  outs() << tus << " translation units\n";
+  return 0;
+}
+
+// build the key index over everything the inputs mention
+int BuildIndex() {
+  if (OutputFile.empty()) {
+    errs() << "dead-method-wp: index mode needs -o <file>\n";
+    return 1;
+  }
+  std::vector<std::string> keys;
+  KeySink sink(keys);
+  if (!LoadInputs(sink))
+    return 1;
+
+  std::string error;
+  tool_output_file out(OutputFile.c_str(), error, raw_fd_ostream::F_Binary);
+  if (!error.empty()) {
+    Fail(OutputFile, error);
+    return 1;
+  }
+  KeyIndex::Build(keys, out.os());
+  out.keep();
+  return 0;
+}
+
+// lookups per second of the index against the string-keyed maps it replaces
+template <typename LookupFn>
+void Bench(StringRef what, const std::vector<StringRef> &keys, LookupFn fn) {
+  unsigned sum = 0;
+  const double start = TimeRecord::getCurrentTime().getWallTime();
+  for (unsigned r = 0; r != BenchRounds; ++r)
+    for (unsigned i = 0, e = keys.size(); i != e; ++i)
+      sum += fn(keys[i]);
+  const double seconds = TimeRecord::getCurrentTime().getWallTime() - start;
+  const double lookups = double(keys.size()) * BenchRounds;
+  outs() << format("%-24s %12.0f lookups/s %8.1f ns/lookup (checksum %u)\n",
+      what.data(), lookups / seconds, seconds * 1e9 / lookups, sum);
+}
+
+struct IndexLookup {
+  const KeyIndex &index;
+  IndexLookup(const KeyIndex &i) : index(i) { }
+  unsigned operator()(StringRef key) const { return index.Lookup(key); }
+};
+
+struct StringMapLookup {
+  const StringMap<unsigned> &map;
+  StringMapLookup(const StringMap<unsigned> &m) : map(m) { }
+  unsigned operator()(StringRef key) const {
+    return map.find(key)->getValue();
+  }
+};
+
+struct StdMapLookup {
+  const std::map<std::string, unsigned> &map;
+  StdMapLookup(const std::map<std::string, unsigned> &m) : map(m) { }
+  unsigned operator()(StringRef key) const {
+    return map.find(key)->second;
+  }
+};
+
+int BenchIndex() {
+  if (Inputs.size() != 1) {
+    errs() << "dead-method-wp: bench-index mode needs one key index\n";
+    return 1;
+  }
+  KeyIndex index;
+  std::string error;
+  if (!index.Load(Inputs[0], error)) {
+    Fail(Inputs[0], error);
+    return 1;
+  }
+
+  // query in a scrambled order so that neighbouring IDs do not share lines
+  std::vector<StringRef> keys;
+  StringMap<unsigned> stringMap;
+  std::map<std::string, unsigned> stdMap;
+  for (unsigned i = 0, e = index.size(); i != e; ++i) {
+    keys.push_back(index.Key((i * 2654435761u) % e));
+    stringMap[index.Key(i)] = i;
+    stdMap[index.Key(i)] = i;
+  }
+  outs() << index.size() << " keys, " << BenchRounds << " rounds\n";
+  Bench("minimal perfect hash", keys, IndexLookup(index));
+  Bench("llvm::StringMap", keys, StringMapLookup(stringMap));
+  Bench("std::map", keys, StdMapLookup(stdMap));
+  return 0;
+}
+
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+  Argv0 = argv[0];
+
+  cl::ParseCommandLineOptions(argc, argv,
+      "dead-method whole-program driver\n\n"
+      "  report       merge the facts of the given inputs and print the\n"
+      "               private methods that are unused in the whole program\n"
+      "  run          like report, but analyse the given sources (default:\n"
+      "               all of -p) in -j worker processes first\n"
+      "  worker       used by run\n"
+      "  plan         print the translation units that close the given\n"
+      "               classes, according to -closure\n"
+      "  check        analyse just those, in -j worker processes, and\n"
+      "               report on the given classes\n"
+      "  visibility   taking each input as one shared library (or\n"
+      "               executable), print the exported classes and methods\n"
+      "               used only inside the library defining them\n"
+      "  virtuality   print the hierarchies of dynamic classes whose\n"
+      "               virtual methods are never called virtually\n"
+      "  perf-totals  sum the perf-counters lines of the plugin found in\n"
+      "               the given logs (default: stdin) per phase\n"
+      "  index        build a key index (-o) over the keys of the inputs\n"
+      "  bench-index  measure lookup throughput of the given key index\n");
+
+  if (Mode == "report")
+    return Report();
+  if (Mode == "run")
+    return Run();
+  if (Mode == "worker")
+    return RunWorker(BuildPath);
+  if (Mode == "plan")
+    return PrintPlan();
+  if (Mode == "check")
+    return Check();
+  if (Mode == "visibility")
+    return AdviseVisibility();
+  if (Mode == "virtuality")
+    return AdviseVirtuality();
+  if (Mode == "perf-totals")
+    return PerfTotals();
+  if (Mode == "index")
+    return BuildIndex();
+  if (Mode == "bench-index")
+    return BenchIndex();
+
+  errs() << "dead-method-wp: unknown mode '" << Mode << "'\n";
+  return 1;
+}
@@ -0,0 +1,163 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Construction and loading of the minimal perfect hash key index.
+//
+#include "KeyIndex.h"
+#include "DeadFacts.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include <algorithm>
+
+using namespace deadwp;
+
+namespace {
+
+const uint32_t IndexMagic = 0x494b4d44; // "DMKI"
+const uint32_t IndexVersion = 1;
+const unsigned HeaderWords = 5;
+// average number of keys per bucket
+const unsigned BucketLoad = 4;
+// displacements tried per bucket before giving up on a seed
+const unsigned MaxTries = 1u << 22;
+
+struct BySizeDesc {
+  const std::vector<std::vector<unsigned> > &buckets;
+  BySizeDesc(const std::vector<std::vector<unsigned> > &b) : buckets(b) { }
+  bool operator()(unsigned a, unsigned b) const {
+    return buckets[a].size() > buckets[b].size();
+  }
+};
+
+}
+
+// Hash and displace: place the buckets largest first, each with the first
+// displacement that sends all its keys to distinct free slots. The single
+// key buckets come last and need no search: with d < n the key lands in
+// slot (h + d) % n, so each takes the next free slot directly.
+void KeyIndex::Build(std::vector<std::string> keys, llvm::raw_ostream &os) {
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  const unsigned n = keys.size();
+  const unsigned b = n / BucketLoad + 1;
+  std::vector<uint32_t> disp(b, 0);
+  std::vector<unsigned> slotKey(n);
+  uint32_t seed = 0;
+
+  for (bool placed = false; !placed && n; ++seed) {
+    std::vector<uint64_t> hashes(n);
+    std::vector<std::vector<unsigned> > buckets(b);
+    for (unsigned i = 0; i != n; ++i) {
+      hashes[i] = Hash(keys[i], seed);
+      buckets[Bucket(hashes[i], b)].push_back(i);
+    }
+    std::vector<unsigned> order(b);
+    for (unsigned i = 0; i != b; ++i)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), BySizeDesc(buckets));
+
+    std::vector<bool> taken(n, false);
+    std::vector<unsigned> slots;
+    // first slot that may be free, for the single key buckets
+    unsigned nextFree = 0;
+    placed = true;
+    for (unsigned i = 0; placed && i != b; ++i) {
+      const std::vector<unsigned> &bucket = buckets[order[i]];
+      if (bucket.empty())
+        break;
+      if (bucket.size() == 1) {
+        while (taken[nextFree])
+          ++nextFree;
+        const unsigned h = uint32_t(hashes[bucket[0]]) % n;
+        disp[order[i]] = (nextFree + n - h) % n;
+        taken[nextFree] = true;
+        slotKey[nextFree] = bucket[0];
+        continue;
+      }
+
+      bool found = false;
+      for (uint32_t d = 0; !found && d != MaxTries; ++d) {
+        slots.clear();
+        found = true;
+        for (unsigned k = 0, ke = bucket.size(); found && k != ke; ++k) {
+          const unsigned s = Slot(hashes[bucket[k]], d, n);
+          found = !taken[s] &&
+            std::find(slots.begin(), slots.end(), s) == slots.end();
+          slots.push_back(s);
+        }
+        if (found) {
+          disp[order[i]] = d;
+          for (unsigned k = 0, ke = bucket.size(); k != ke; ++k) {
+            taken[slots[k]] = true;
+            slotKey[slots[k]] = bucket[k];
+          }
+        }
+      }
+      placed = found;
+    }
+    if (placed)
+      break;
+  }
+
+  deadfacts::WriteU32(os, IndexMagic);
+  deadfacts::WriteU32(os, IndexVersion);
+  deadfacts::WriteU32(os, n);
+  deadfacts::WriteU32(os, b);
+  deadfacts::WriteU32(os, seed);
+  for (unsigned i = 0; i != b; ++i)
+    deadfacts::WriteU32(os, disp[i]);
+  uint32_t offset = 0;
+  for (unsigned i = 0; i != n; ++i) {
+    deadfacts::WriteU32(os, offset);
+    offset += keys[slotKey[i]].size();
+  }
+  deadfacts::WriteU32(os, offset);
+  for (unsigned i = 0; i != n; ++i)
+    os << keys[slotKey[i]];
+}
+
+bool KeyIndex::Load(llvm::StringRef path, std::string &error) {
+  if (llvm::error_code ec = llvm::MemoryBuffer::getFile(path, buffer)) {
+    error = ec.message();
+    return false;
+  }
+
+  const char *start = buffer->getBufferStart();
+  const size_t size = buffer->getBufferSize();
+  const Word *header = reinterpret_cast<const Word *>(start);
+  if (size < HeaderWords * 4 || header[0] != IndexMagic ||
+      header[1] != IndexVersion) {
+    error = "not a key index";
+    return false;
+  }
+  numKeys = header[2];
+  numBuckets = header[3];
+  seed = header[4];
+
+  if (!numBuckets) {
+    error = "corrupt key index";
+    return false;
+  }
+
+  const uint64_t words = uint64_t(HeaderWords) + numBuckets + numKeys + 1;
+  if (size < words * 4) {
+    error = "truncated key index";
+    return false;
+  }
+  displacements = header + HeaderWords;
+  offsets = displacements + numBuckets;
+  pool = start + words * 4;
+  // Key() trusts the offsets, so they must be ordered and inside the pool
+  for (unsigned i = 0; i != numKeys; ++i)
+    if (offsets[i] > offsets[i + 1]) {
+      error = "corrupt key index";
+      return false;
+    }
+  if (size - words * 4 < offsets[numKeys]) {
+    error = "truncated key index";
+    return false;
+  }
+  return true;
+}
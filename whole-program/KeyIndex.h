@@ -0,0 +1,104 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Minimal perfect hash over the entity keys (the plugin's USRs) of a build,
+// so that the driver can work with dense integer IDs and plain arrays instead
+// of string-keyed maps.
+//
+// The index is built once (dead-method-wp index) and used straight from the
+// mapped file. Layout, all integers 32-bit little endian:
+//   header        magic, version, number of keys n, number of buckets b, seed
+//   displacement  b entries
+//   key offsets   n + 1 entries into the string pool, in ID order
+//   string pool   the keys, back to back
+// A key hashes to a bucket; the bucket's displacement picks the slot (the
+// ID) among n. Lookups compare the stored key, so unknown keys are detected.
+//
+#ifndef DEAD_METHOD_KEY_INDEX_H
+#define DEAD_METHOD_KEY_INDEX_H
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace deadwp {
+
+class KeyIndex {
+  public:
+    static const unsigned NotFound = ~0u;
+
+    KeyIndex() : numKeys(0), numBuckets(0), seed(0), displacements(0),
+      offsets(0), pool(0) { }
+
+    // build the index over 'keys' (duplicates allowed) and write it to 'os'
+    static void Build(std::vector<std::string> keys, llvm::raw_ostream &os);
+
+    // map an index file; returns false and sets 'error' on failure
+    bool Load(llvm::StringRef path, std::string &error);
+
+    // ID of the key or NotFound
+    unsigned Lookup(llvm::StringRef key) const {
+      if (!numKeys)
+        return NotFound;
+      const uint64_t h = Hash(key, seed);
+      const unsigned id = Slot(h, displacements[Bucket(h, numBuckets)],
+          numKeys);
+      return Key(id) == key ? id : NotFound;
+    }
+
+    llvm::StringRef Key(unsigned id) const {
+      return llvm::StringRef(pool + offsets[id],
+          offsets[id + 1] - offsets[id]);
+    }
+
+    unsigned size() const { return numKeys; }
+  private:
+    typedef llvm::support::ulittle32_t Word;
+
+    llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+    unsigned numKeys;
+    unsigned numBuckets;
+    uint32_t seed;
+    const Word *displacements;
+    const Word *offsets;
+    const char *pool;
+
+    // seeded 64-bit FNV-1a with a final avalanche; one pass over the key
+    // yields both the bucket and the two slot hashes
+    static uint64_t Hash(llvm::StringRef key, uint32_t seed) {
+      uint64_t h = 14695981039346656037ULL ^ seed;
+      for (size_t i = 0, e = key.size(); i != e; ++i) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+      }
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+
+    static unsigned Bucket(uint64_t h, unsigned numBuckets) {
+      return (h >> 40) % numBuckets;
+    }
+
+    // displacement d encodes the pair (d / n, d % n)
+    static unsigned Slot(uint64_t h, uint32_t d, unsigned n) {
+      const uint32_t f1 = uint32_t(h), f2 = uint32_t(h >> 20) | 1;
+      return (uint64_t(f1) + uint64_t(d / n) * f2 + d % n) % n;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,247 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Merging of per translation unit facts and the program-wide closure.
+//
+#include "Program.h"
+#include "KeyIndex.h"
+#include <algorithm>
+
+using namespace deadwp;
+
+namespace {
+
+// defining translation units kept per entity; any one of them will do
+const unsigned MaxDefiners = 4;
+
+// order findings the way a compiler would print them
+struct ByLocation {
+  bool operator()(const MethodInfo *a, const MethodInfo *b) const {
+    if (a->file != b->file)
+      return a->file < b->file;
+    if (a->line != b->line)
+      return a->line < b->line;
+    return a->name < b->name;
+  }
+};
+
+}
+
+Program::Program(bool includeTemplateMethods,
+    const std::vector<std::string> &ignored, const KeyIndex *idx)
+  : templatesAlso(includeTemplateMethods), blacklist(ignored), index(idx),
+  nextId(idx ? idx->size() : 0), numTUs(0) {
+  std::sort(blacklist.begin(), blacklist.end());
+  methods.resize(nextId);
+  classes.resize(nextId);
+  functionDefined.resize(nextId);
+  definers.resize(nextId);
+}
+
+unsigned Program::Id(llvm::StringRef key) {
+  if (index) {
+    const unsigned id = index->Lookup(key);
+    if (id != KeyIndex::NotFound)
+      return id;
+  }
+  llvm::StringMap<unsigned>::iterator it = extraIds.find(key);
+  if (it != extraIds.end())
+    return it->getValue();
+
+  const unsigned id = nextId++;
+  extraIds[key] = id;
+  methods.resize(nextId);
+  classes.resize(nextId);
+  functionDefined.resize(nextId);
+  definers.resize(nextId);
+  return id;
+}
+
+void Program::Ids(const std::vector<std::string> &keys,
+    std::vector<unsigned> &ids) {
+  ids.resize(keys.size());
+  for (unsigned i = 0, e = keys.size(); i != e; ++i)
+    ids[i] = Id(keys[i]);
+}
+
+void Program::Defined(unsigned id) {
+  std::vector<unsigned> &tus = definers[id];
+  if (tus.size() < MaxDefiners && (tus.empty() || tus.back() != numTUs - 1))
+    tus.push_back(numTUs - 1);
+}
+
+void Program::AddFacts(const deadfacts::TUFacts &facts) {
+  ++numTUs;
+  tuNames.push_back(facts.tu);
+
+  for (unsigned i = 0, e = facts.classes.size(); i != e; ++i) {
+    const deadfacts::ClassFact &f = facts.classes[i];
+    const unsigned id = Id(f.key);
+    // nested classes count as soon as they are declared: they may be
+    // defined in a translation unit yet to come
+    if (classes[id].key.empty()) {
+      classes[id].key = f.key;
+      if (!f.outer.empty()) {
+        const unsigned outer = Id(f.outer);
+        classes[outer].nested.push_back(id);
+      }
+    }
+    // friends come from the definition, which is the same everywhere
+    if (f.defined && !classes[id].defined) {
+      std::vector<unsigned> friendFunctions, friendClasses;
+      Ids(f.friendFunctions, friendFunctions);
+      Ids(f.friendClasses, friendClasses);
+      ClassInfo &c = classes[id];
+      c.defined = true;
+      c.friendFunctions.swap(friendFunctions);
+      c.friendClasses.swap(friendClasses);
+    }
+    classes[id].name = f.name;
+  }
+
+  for (unsigned i = 0, e = facts.methods.size(); i != e; ++i) {
+    const deadfacts::MethodFact &f = facts.methods[i];
+    const unsigned id = Id(f.key);
+    const unsigned classId = Id(f.classKey);
+    MethodInfo &m = methods[id];
+    if (!m.declared) {
+      m.declared = true;
+      m.classId = classId;
+      m.name = f.name;
+      m.file = f.file;
+      m.line = f.line;
+      classes[classId].methods.push_back(id);
+    }
+    // a definition seen anywhere counts
+    m.flags |= f.flags;
+    if (f.flags & deadfacts::MF_Defined)
+      Defined(id);
+    if (f.cost) {
+      m.cost += f.cost;
+      ++m.costTUs;
+    }
+  }
+
+  for (unsigned i = 0, e = facts.functions.size(); i != e; ++i) {
+    const unsigned id = Id(facts.functions[i].key);
+    functionDefined[id] |= facts.functions[i].defined;
+    if (facts.functions[i].defined)
+      Defined(id);
+  }
+
+  // references may precede the declaration (e.g. members of implicit
+  // instantiations, which are not recorded)
+  for (unsigned i = 0, e = facts.refs.size(); i != e; ++i) {
+    const unsigned id = Id(facts.refs[i].key);
+    methods[id].refs += facts.refs[i].count;
+  }
+}
+
+// a private method nobody refers to, worth reporting if the class is closed
+bool Program::IsUnused(const MethodInfo &m) const {
+  if (!m.declared || !(m.flags & deadfacts::MF_Private) || m.refs)
+    return false;
+
+  // some people declare private never used ctors/dtors purposefully
+  if (m.flags & deadfacts::MF_Structor)
+    return false;
+
+  if ((m.flags & deadfacts::MF_Templated) && !templatesAlso)
+    return false;
+
+  return !IsBlacklisted(m.file);
+}
+
+void Program::FindUnused(std::vector<const MethodInfo *> &unused) const {
+  for (unsigned id = 0, e = methods.size(); id != e; ++id) {
+    const MethodInfo &m = methods[id];
+    if (IsUnused(m) && IsClosed(m.classId))
+      unused.push_back(&m);
+  }
+  std::sort(unused.begin(), unused.end(), ByLocation());
+}
+
+bool Program::FindUnusedIn(unsigned classId,
+    std::vector<const MethodInfo *> &unused) const {
+  if (!IsClosed(classId))
+    return false;
+  const ClassInfo &c = classes[classId];
+  for (unsigned i = 0, e = c.methods.size(); i != e; ++i) {
+    const MethodInfo &m = methods[c.methods[i]];
+    if (IsUnused(m))
+      unused.push_back(&m);
+  }
+  std::sort(unused.begin(), unused.end(), ByLocation());
+  return true;
+}
+
+// the class and all its methods are defined somewhere
+bool Program::IsComplete(unsigned classId) const {
+  const ClassInfo &c = classes[classId];
+  if (!c.defined)
+    return false;
+
+  for (unsigned i = 0, e = c.methods.size(); i != e; ++i)
+    if (!(methods[c.methods[i]].flags & deadfacts::MF_Defined))
+      return false;
+  return true;
+}
+
+// complete, and so are all the friends and the nested classes (with theirs)
+bool Program::IsClosed(unsigned classId) const {
+  if (!IsComplete(classId))
+    return false;
+
+  const ClassInfo &c = classes[classId];
+  for (unsigned i = 0, e = c.friendFunctions.size(); i != e; ++i)
+    if (!functionDefined[c.friendFunctions[i]])
+      return false;
+  for (unsigned i = 0, e = c.friendClasses.size(); i != e; ++i)
+    if (!IsComplete(c.friendClasses[i]))
+      return false;
+
+  std::vector<unsigned> nested(c.nested);
+  while (!nested.empty()) {
+    const unsigned id = nested.back();
+    nested.pop_back();
+    if (!IsComplete(id))
+      return false;
+    nested.insert(nested.end(), classes[id].nested.begin(),
+        classes[id].nested.end());
+  }
+  return true;
+}
+
+void Program::AddRequirements(const std::vector<unsigned> &methodIds,
+    std::vector<std::vector<unsigned> > &requirements) const {
+  for (unsigned i = 0, e = methodIds.size(); i != e; ++i)
+    requirements.push_back(definers[methodIds[i]]);
+}
+
+void Program::Requirements(unsigned classId,
+    std::vector<std::vector<unsigned> > &requirements) const {
+  const ClassInfo &c = classes[classId];
+  AddRequirements(c.methods, requirements);
+  AddRequirements(c.friendFunctions, requirements);
+  for (unsigned i = 0, e = c.friendClasses.size(); i != e; ++i)
+    AddRequirements(classes[c.friendClasses[i]].methods, requirements);
+  std::vector<unsigned> nested(c.nested);
+  while (!nested.empty()) {
+    const ClassInfo &n = classes[nested.back()];
+    nested.pop_back();
+    AddRequirements(n.methods, requirements);
+    nested.insert(nested.end(), n.nested.begin(), n.nested.end());
+  }
+
+  // most methods share the translation unit of the class
+  std::sort(requirements.begin(), requirements.end());
+  requirements.erase(std::unique(requirements.begin(), requirements.end()),
+      requirements.end());
+}
+
+bool Program::IsBlacklisted(const std::string &file) const {
+  std::vector<std::string>::const_iterator it =
+    std::lower_bound(blacklist.begin(), blacklist.end(), file);
+  return it != blacklist.end() && *it == file;
+}
@@ -0,0 +1,121 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Program-wide view built from the facts of every translation unit. A class
+// is closed when some translation unit defines it, each of its methods, each
+// of its friends and each of its nested classes; a private method of a closed
+// class is unused when no translation unit references it.
+//
+// Every body that may refer to a private method is then known, so a class
+// can be judged as soon as it is closed, before all the facts are in.
+//
+// Keys are turned into dense IDs as soon as facts come in, through the key
+// index when one is given; everything else is arrays indexed by ID.
+//
+#ifndef DEAD_METHOD_PROGRAM_H
+#define DEAD_METHOD_PROGRAM_H
+
+#include "DeadFacts.h"
+#include "llvm/ADT/StringMap.h"
+#include <string>
+#include <vector>
+
+namespace deadwp {
+
+class KeyIndex;
+
+struct MethodInfo {
+  std::string name;
+  std::string file;
+  unsigned classId;
+  unsigned line;
+  unsigned flags;
+  // references summed over all the translation units
+  unsigned refs;
+  // some translation unit declared it (references may come first)
+  bool declared;
+  // code generation time summed over the translation units that emitted
+  // it (profile-cost), in microseconds, and their number
+  uint64_t cost;
+  unsigned costTUs;
+
+  MethodInfo()
+    : classId(0), line(0), flags(0), refs(0), declared(false), cost(0),
+    costTUs(0) { }
+};
+
+struct ClassInfo {
+  std::string key;
+  std::string name;
+  bool defined;
+  std::vector<unsigned> friendFunctions;
+  std::vector<unsigned> friendClasses;
+  std::vector<unsigned> nested;
+  std::vector<unsigned> methods;
+
+  ClassInfo() : defined(false) { }
+};
+
+class Program {
+  public:
+    // 'index' (optional) must outlive the program
+    Program(bool includeTemplateMethods,
+        const std::vector<std::string> &ignored, const KeyIndex *index = 0);
+
+    void AddFacts(const deadfacts::TUFacts &facts);
+
+    // unused private methods of closed classes, ordered by location
+    void FindUnused(std::vector<const MethodInfo *> &unused) const;
+    // the same for one class; false if it is not closed (yet)
+    bool FindUnusedIn(unsigned classId,
+        std::vector<const MethodInfo *> &unused) const;
+
+    // For each method, friend function and method of a friend or nested
+    // class: the translation units that define it (a few of them). One of
+    // each set has to be seen for the class to close.
+    void Requirements(unsigned classId,
+        std::vector<std::vector<unsigned> > &requirements) const;
+
+    unsigned NumTranslationUnits() const { return numTUs; }
+    const std::string &TranslationUnit(unsigned tu) const {
+      return tuNames[tu];
+    }
+    // IDs run up to NumIds(); not each of them is a class
+    unsigned NumIds() const { return nextId; }
+    const ClassInfo &Class(unsigned id) const { return classes[id]; }
+    const MethodInfo &Method(unsigned id) const { return methods[id]; }
+    // assigned on first use; may grow the arrays, so do not hold references
+    // into the program across calls
+    unsigned Id(llvm::StringRef key);
+  private:
+    bool templatesAlso;
+    // sorted list of file paths that should be ignored
+    std::vector<std::string> blacklist;
+    const KeyIndex *index;
+    // IDs of the keys the index does not know (all of them without index)
+    llvm::StringMap<unsigned> extraIds;
+    unsigned nextId;
+    std::vector<MethodInfo> methods;
+    std::vector<ClassInfo> classes;
+    // friend functions, whether some translation unit defines them
+    std::vector<char> functionDefined;
+    // methods and friend functions, the first translation units defining
+    // them
+    std::vector<std::vector<unsigned> > definers;
+    unsigned numTUs;
+    std::vector<std::string> tuNames;
+
+    void Ids(const std::vector<std::string> &keys, std::vector<unsigned> &ids);
+    void Defined(unsigned id);
+    bool IsUnused(const MethodInfo &m) const;
+    bool IsClosed(unsigned classId) const;
+    bool IsComplete(unsigned classId) const;
+    void AddRequirements(const std::vector<unsigned> &methodIds,
+        std::vector<std::vector<unsigned> > &requirements) const;
+    bool IsBlacklisted(const std::string &file) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Hierarchies of dynamic classes and the virtual calls into them.
+//
+#include "Virtuality.h"
+#include <algorithm>
+
+using namespace deadwp;
+
+namespace {
+
+// the representative of the set of 'i', halving the paths on the way
+unsigned FindRoot(std::vector<unsigned> &parent, unsigned i) {
+  while (parent[i] != i)
+    i = parent[i] = parent[parent[i]];
+  return i;
+}
+
+}
+
+void VirtualityAdvisor::AddFacts(const deadfacts::TUFacts &facts) {
+  program.AddFacts(facts);
+  // The program gives IDs to classes, methods and functions, but not to
+  // bases or dynamic uses that are no class of the facts (e.g. implicit
+  // instantiations, which are not recorded); all the keys need theirs
+  // before the arrays can be sized.
+  for (unsigned i = 0, e = facts.classes.size(); i != e; ++i)
+    for (unsigned j = 0, je = facts.classes[i].bases.size(); j != je; ++j)
+      program.Id(facts.classes[i].bases[j]);
+  for (unsigned i = 0, e = facts.dynamicUses.size(); i != e; ++i)
+    program.Id(facts.dynamicUses[i]);
+  info.resize(program.NumIds());
+  defined.resize(program.NumIds());
+  virtualCalls.resize(program.NumIds());
+
+  for (unsigned i = 0, e = facts.classes.size(); i != e; ++i) {
+    const deadfacts::ClassFact &f = facts.classes[i];
+    const unsigned id = program.Id(f.key);
+    if (!f.defined || defined[id])
+      continue;
+    defined[id] = true;
+    VTableInfo &c = info[id];
+    for (unsigned j = 0, je = f.bases.size(); j != je; ++j)
+      c.bases.push_back(program.Id(f.bases[j]));
+    c.file = f.file;
+    c.line = f.line;
+    c.vptrBytes = f.vptrBytes;
+    c.vtableBytes = f.vtableBytes;
+    c.size = f.size;
+    c.vptrRequired = f.vptrRequired;
+  }
+
+  for (unsigned i = 0, e = facts.refs.size(); i != e; ++i)
+    virtualCalls[program.Id(facts.refs[i].key)] +=
+      facts.refs[i].virtualCount;
+
+  for (unsigned i = 0, e = facts.dynamicUses.size(); i != e; ++i)
+    info[program.Id(facts.dynamicUses[i])].dynamicUse = true;
+}
+
+bool VirtualityAdvisor::IsDynamic(unsigned id) const {
+  return info[id].vptrBytes || info[id].vptrRequired;
+}
+
+void VirtualityAdvisor::Find(std::vector<Hierarchy> &hierarchies) const {
+  // union-find over the dynamic classes, joined with their dynamic bases;
+  // a class of unknown definition taints its derived ones
+  const unsigned n = info.size();
+  std::vector<unsigned> parent(n);
+  for (unsigned i = 0; i != n; ++i)
+    parent[i] = i;
+
+  std::vector<char> blocked(n);
+  for (unsigned i = 0; i != n; ++i) {
+    if (!IsDynamic(i))
+      continue;
+    const VTableInfo &c = info[i];
+    if (c.vptrRequired || c.dynamicUse)
+      blocked[i] = true;
+    for (unsigned j = 0, je = c.bases.size(); j != je; ++j) {
+      const unsigned b = c.bases[j];
+      if (!defined[b])
+        blocked[i] = true;
+      else if (IsDynamic(b))
+        parent[FindRoot(parent, i)] = FindRoot(parent, b);
+    }
+    const std::vector<unsigned> &methods = program.Class(i).methods;
+    for (unsigned j = 0, je = methods.size(); j != je; ++j) {
+      const unsigned flags = program.Method(methods[j]).flags;
+      if (!(flags & deadfacts::MF_Virtual))
+        continue;
+      // not defined anywhere: the body, and maybe calls, are elsewhere
+      if (virtualCalls[methods[j]] ||
+          !(flags & (deadfacts::MF_Defined | deadfacts::MF_Pure)))
+        blocked[i] = true;
+    }
+  }
+
+  std::vector<char> blockedRoot(n);
+  for (unsigned i = 0; i != n; ++i)
+    if (blocked[i])
+      blockedRoot[FindRoot(parent, i)] = true;
+
+  // gather the classes per hierarchy
+  std::vector<unsigned> index(n, ~0u);
+  for (unsigned i = 0; i != n; ++i) {
+    const unsigned root = FindRoot(parent, i);
+    if (!IsDynamic(i) || blockedRoot[root])
+      continue;
+    if (index[root] == ~0u) {
+      index[root] = hierarchies.size();
+      hierarchies.push_back(Hierarchy());
+      hierarchies.back().calls = 0;
+      hierarchies.back().vtableBytes = 0;
+    }
+    Hierarchy &h = hierarchies[index[root]];
+    h.classes.push_back(i);
+    h.vtableBytes += info[i].vtableBytes;
+    const std::vector<unsigned> &methods = program.Class(i).methods;
+    for (unsigned j = 0, je = methods.size(); j != je; ++j) {
+      const MethodInfo &m = program.Method(methods[j]);
+      if (m.flags & deadfacts::MF_Virtual)
+        h.calls += m.refs - virtualCalls[methods[j]];
+    }
+  }
+}
@@ -0,0 +1,77 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Finds dynamic classes that would not miss their vtables. Classes deriving
+// from one another form a hierarchy; if no call anywhere in the program
+// dispatches a virtual method of the hierarchy through the vtable, no member
+// pointer to one exists and nothing consults the vtables otherwise
+// (dynamic_cast, typeid, delete through a base), the methods could all be
+// made non-virtual and the objects would lose their vtable pointers.
+//
+// Hierarchies are left alone when part of them is out of sight: a base not
+// defined by any translation unit, a virtual method not defined by any (it
+// may be called from a library), virtual bases or class templates.
+//
+// Methods and classes are known by the IDs of the Program the facts are
+// merged into.
+//
+#ifndef DEAD_METHOD_VIRTUALITY_H
+#define DEAD_METHOD_VIRTUALITY_H
+
+#include "Program.h"
+#include <string>
+#include <vector>
+
+namespace deadwp {
+
+class VirtualityAdvisor {
+  public:
+    // what the program does not know about a class
+    struct VTableInfo {
+      // of the definition
+      std::string file;
+      unsigned line;
+      std::vector<unsigned> bases;
+      uint32_t vptrBytes;
+      uint32_t vtableBytes;
+      uint32_t size;
+      bool vptrRequired;
+      bool dynamicUse;
+
+      VTableInfo()
+        : line(0), vptrBytes(0), vtableBytes(0), size(0), vptrRequired(false),
+        dynamicUse(false) { }
+    };
+
+    // a hierarchy whose virtuality could go
+    struct Hierarchy {
+      // by ID
+      std::vector<unsigned> classes;
+      // direct calls of its virtual methods, none being virtual
+      unsigned calls;
+      // of the vtables
+      uint64_t vtableBytes;
+    };
+
+    // the facts are merged into 'program', which must outlive the advisor
+    VirtualityAdvisor(Program &p) : program(p) { }
+
+    void AddFacts(const deadfacts::TUFacts &facts);
+    void Find(std::vector<Hierarchy> &hierarchies) const;
+
+    const VTableInfo &Info(unsigned id) const { return info[id]; }
+  private:
+    Program &program;
+    // by ID
+    std::vector<VTableInfo> info;
+    std::vector<char> defined;
+    // virtual calls of each method
+    std::vector<unsigned> virtualCalls;
+
+    bool IsDynamic(unsigned id) const;
+};
+
+}
+
+#endif
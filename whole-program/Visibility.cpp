@@ -0,0 +1,109 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Per library bookkeeping of definitions and references for the
+// hidden-visibility advice.
+//
+#include "Visibility.h"
+#include <algorithm>
+
+using namespace deadwp;
+
+namespace {
+
+bool Includes(const std::vector<unsigned> &v, unsigned x) {
+  return std::binary_search(v.begin(), v.end(), x);
+}
+
+}
+
+unsigned VisibilityAdvisor::AddLibrary(llvm::StringRef name) {
+  libraries.push_back(name.str());
+  return libraries.size() - 1;
+}
+
+void VisibilityAdvisor::Add(std::vector<std::vector<unsigned> > &sets,
+    unsigned id, unsigned library) {
+  std::vector<unsigned> &v = sets[id];
+  std::vector<unsigned>::iterator it =
+    std::lower_bound(v.begin(), v.end(), library);
+  if (it == v.end() || *it != library)
+    v.insert(it, library);
+}
+
+void VisibilityAdvisor::AddFacts(unsigned library,
+    const deadfacts::TUFacts &facts) {
+  program.AddFacts(facts);
+  // the keys have their IDs now
+  definedIn.resize(program.NumIds());
+  referencedFrom.resize(program.NumIds());
+  for (unsigned i = 0, e = facts.classes.size(); i != e; ++i)
+    if (facts.classes[i].defined)
+      Add(definedIn, program.Id(facts.classes[i].key), library);
+  for (unsigned i = 0, e = facts.methods.size(); i != e; ++i)
+    if (facts.methods[i].flags & deadfacts::MF_Defined)
+      Add(definedIn, program.Id(facts.methods[i].key), library);
+  for (unsigned i = 0, e = facts.refs.size(); i != e; ++i)
+    Add(referencedFrom, program.Id(facts.refs[i].key), library);
+}
+
+void VisibilityAdvisor::Saves(unsigned id, Savings &savings) const {
+  savings.symbols += definedIn[id].size();
+  savings.relocations += referencedFrom[id].size();
+}
+
+bool VisibilityAdvisor::CanHideMethod(unsigned id, Savings &savings) const {
+  const MethodInfo &m = program.Method(id);
+  // declared only (e.g. members of implicit instantiations), or hidden
+  // already
+  if (!m.declared || !(m.flags & deadfacts::MF_Exported) ||
+      definedIn[id].empty())
+    return false;
+  if (m.flags & deadfacts::MF_Virtual)
+    return false;
+  // the symbols are those of the specializations, which may be used (or
+  // explicitly instantiated) anywhere
+  if (m.flags & (deadfacts::MF_Templated | deadfacts::MF_Dependent))
+    return false;
+  // destroyed by implicit destructors and at the end of scopes
+  if (m.flags & deadfacts::MF_Destructor)
+    return false;
+  // called by implicit constructors and initializers
+  if (m.flags & deadfacts::MF_Structor)
+    return false;
+
+  const std::vector<unsigned> &refs = referencedFrom[id];
+  for (unsigned i = 0, e = refs.size(); i != e; ++i)
+    if (!Includes(definedIn[id], refs[i]))
+      return false;
+  Saves(id, savings);
+  return true;
+}
+
+bool VisibilityAdvisor::CanHideClass(unsigned id, Savings &savings) const {
+  const ClassInfo &c = program.Class(id);
+  // other libraries seeing the definition may construct, destroy or
+  // dynamic_cast objects of it
+  if (c.key.empty() || definedIn[id].size() != 1 || c.methods.empty())
+    return false;
+
+  Savings s;
+  for (unsigned i = 0, e = c.methods.size(); i != e; ++i) {
+    const unsigned method = c.methods[i];
+    const unsigned flags = program.Method(method).flags;
+    if (flags & (deadfacts::MF_Virtual | deadfacts::MF_Dependent))
+      return false;
+    // constructors and the destructor go with the class
+    if (flags & deadfacts::MF_Structor) {
+      if ((flags & deadfacts::MF_Exported) && !definedIn[method].empty())
+        Saves(method, s);
+      continue;
+    }
+    if (!CanHideMethod(method, s))
+      return false;
+  }
+  savings.symbols += s.symbols;
+  savings.relocations += s.relocations;
+  return true;
+}
@@ -0,0 +1,71 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Hidden-visibility advisor. Facts are grouped by the shared library (or
+// executable) their translation units were linked into; an exported method
+// whose every reference comes from a library that defines it (inline methods
+// have a copy in each) could be hidden there, and so could a class all of
+// whose methods can, when no other library even sees its definition.
+//
+// Every hidden method saves a .dynsym entry in each library defining it and
+// the PLT relocation in each library calling it, as calls then bind locally.
+// Virtual methods are left alone: vtables elsewhere may refer to them. So
+// are constructors and destructors on their own, as implicit members and
+// initializers call them without the facts seeing it; with the whole class
+// they go, since no other library can create or destroy an object of it.
+//
+// Methods and classes are known by the IDs of the Program the facts are
+// merged into.
+//
+#ifndef DEAD_METHOD_VISIBILITY_H
+#define DEAD_METHOD_VISIBILITY_H
+
+#include "Program.h"
+#include <string>
+#include <vector>
+
+namespace deadwp {
+
+class VisibilityAdvisor {
+  public:
+    // what hiding saves
+    struct Savings {
+      unsigned symbols;
+      unsigned relocations;
+
+      Savings() : symbols(0), relocations(0) { }
+    };
+
+    // the facts are merged into 'program', which must outlive the advisor
+    VisibilityAdvisor(Program &p) : program(p) { }
+
+    // returns the number of the library
+    unsigned AddLibrary(llvm::StringRef name);
+    void AddFacts(unsigned library, const deadfacts::TUFacts &facts);
+
+    // whether the method could be hidden, and what that saves
+    bool CanHideMethod(unsigned id, Savings &savings) const;
+    // whether the whole class could be, in the one library defining it
+    bool CanHideClass(unsigned id, Savings &savings) const;
+    // libraries defining the method or having the definition of the class
+    const std::vector<unsigned> &DefinedIn(unsigned id) const {
+      return definedIn[id];
+    }
+
+    const std::vector<std::string> &Libraries() const { return libraries; }
+  private:
+    Program &program;
+    std::vector<std::string> libraries;
+    // by ID, sorted
+    std::vector<std::vector<unsigned> > definedIn;
+    std::vector<std::vector<unsigned> > referencedFrom;
+
+    void Add(std::vector<std::vector<unsigned> > &sets, unsigned id,
+        unsigned library);
+    void Saves(unsigned id, Savings &savings) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+//
+// Clang plugin: dead-method
+// Author: Adam Głowacki
+// ----------------------------------------------------------------------------
+// Worker side of 'dead-method-wp run': parses the translation units it is
+// handed with the flags from the compilation database and streams their
+// facts back to the coordinator.
+//
+#include "Coordinator.h"
+#include "DeadMethodAnalysis.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cerrno>
+#include <unistd.h>
+
+using namespace clang;
+using namespace deadwp;
+
+namespace {
+
+class FactsConsumer : public ASTConsumer {
+  public:
+    FactsConsumer(deadfacts::TUFacts &f) : facts(f) { }
+
+    virtual void HandleTranslationUnit(ASTContext &ctx) {
+      deadmethod::CollectFacts(ctx, facts);
+    }
+  private:
+    deadfacts::TUFacts &facts;
+};
+
+class FactsAction : public ASTFrontendAction {
+  public:
+    FactsAction(deadfacts::TUFacts &f) : facts(f) { }
+  protected:
+    virtual ASTConsumer *CreateASTConsumer(CompilerInstance &, StringRef) {
+      return new FactsConsumer(facts);
+    }
+  private:
+    deadfacts::TUFacts &facts;
+};
+
+class FactsActionFactory : public tooling::FrontendActionFactory {
+  public:
+    FactsActionFactory(deadfacts::TUFacts &f) : facts(f) { }
+    virtual FrontendAction *create() { return new FactsAction(facts); }
+  private:
+    deadfacts::TUFacts &facts;
+};
+
+// next line of stdin, without the newline; false at the end
+bool ReadLine(std::string &pending, std::string &line) {
+  for (;;) {
+    const size_t eol = pending.find('\n');
+    if (eol != std::string::npos) {
+      line.assign(pending, 0, eol);
+      pending.erase(0, eol + 1);
+      return true;
+    }
+    char buffer[4096];
+    const ssize_t n = read(0, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      // a last line without newline
+      line.swap(pending);
+      pending.clear();
+      return !line.empty();
+    }
+    pending.append(buffer, n);
+  }
+}
+
+}
+
+int deadwp::RunWorker(const std::string &buildPath) {
+  std::string error;
+  llvm::OwningPtr<tooling::CompilationDatabase> db(
+      tooling::CompilationDatabase::loadFromDirectory(buildPath, error));
+  if (!db) {
+    llvm::errs() << "dead-method-wp worker: " << error << "\n";
+    return 1;
+  }
+
+  // The replies go to a private copy of stdout; stdout itself is pointed at
+  // stderr, as ClangTool prints its own messages there.
+  const int protocol = dup(1);
+  if (protocol < 0 || dup2(2, 1) < 0) {
+    llvm::errs() << "dead-method-wp worker: cannot redirect stdout\n";
+    return 1;
+  }
+  llvm::raw_fd_ostream out(protocol, true);
+
+  // ClangTool changes into the directory of each compile command and stays
+  // there; relative names are the coordinator's, so come back every time
+  llvm::SmallString<256> cwdPath;
+  if (llvm::sys::fs::current_path(cwdPath)) {
+    llvm::errs() << "dead-method-wp worker: cannot get the current "
+      "directory\n";
+    return 1;
+  }
+  const std::string cwd = cwdPath.str();
+  deadfacts::WriteU32(out, WS_Ready);
+  out.flush();
+  std::string pending, tu;
+  while (ReadLine(pending, tu)) {
+    deadfacts::TUFacts facts;
+    FactsActionFactory factory(facts);
+    tooling::ClangTool tool(*db, std::vector<std::string>(1, tu));
+
+    const int status = tool.run(&factory);
+    if (chdir(cwd.c_str()) != 0) {
+      llvm::errs() << "dead-method-wp worker: cannot return to " << cwd
+        << "\n";
+      return 1;
+    }
+    if (status == 0) {
+      deadfacts::WriteU32(out, WS_Facts);
+      deadfacts::WriteFacts(out, facts);
+    } else
+      deadfacts::WriteU32(out, WS_Failed);
+    out.flush();
+  }
+  return 0;
+}